@@ -0,0 +1,20 @@
+#!/bin/bash
+# Compare two benchmark result files ("benchmark,metric,value" lines, as
+# written by scratch/tcp-scalable-bench and scratch/network --bench).
+#
+# Usage: bench-compare.sh OLD NEW
+
+if [ $# -ne 2 ]
+then
+    echo "Usage: $0 OLD NEW" >&2
+    exit 1
+fi
+
+printf "%-14s %-22s %14s %14s %9s\n" benchmark metric old new change
+awk -F, '
+FNR == 1 { next }
+NR == FNR { old[$1 "," $2] = $3; next }
+($1 "," $2) in old {
+    o = old[$1 "," $2]
+    printf "%-14s %-22s %14.6g %14.6g %+8.1f%%\n", $1, $2, o, $3, o != 0 ? ($3 - o) * 100 / o : 0
+}' "$1" "$2"
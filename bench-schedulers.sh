@@ -0,0 +1,54 @@
+#!/bin/bash
+# Run the same scenario with every event scheduler at several flow counts,
+# one run at a time, and tabulate the events per wall-clock second.
+#
+# Usage (inside the container, from the ns-3 directory):
+#   bench-schedulers.sh [--schedulers "map list heap calendar dheap"]
+#                       [--flows "1 8 64"] [--out FILE]
+#                       [-- extra scratch/network arguments]
+
+schedulers="map heap calendar dheap list"
+flows="1 8 64"
+out=/work/bench-schedulers.csv
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+        --schedulers) schedulers="$2"; shift 2;;
+        --flows) flows="$2"; shift 2;;
+        --out) out="$2"; shift 2;;
+        --) shift; break;;
+        *) echo "Unknown option $1" >&2; exit 1;;
+    esac
+done
+
+./waf build > /dev/null || exit 1
+program=$(find "$PWD/build/scratch" -maxdepth 1 -type f -perm -u+x -name '*network*' | head -n 1)
+if [ -z "$program" ]
+then
+    echo "scratch/network is not built" >&2
+    exit 1
+fi
+export LD_LIBRARY_PATH="$PWD/build:$PWD/build/lib:$LD_LIBRARY_PATH"
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+echo "scheduler,flows,events,wall_s,events_per_s,peak_pending_events,max_rss_kb,rx_bytes" > "$out"
+for n in $flows; do
+    for scheduler in $schedulers; do
+        (
+            cd "$dir" || exit 1
+            "$program" --runtime=60 --RngRun=1 --pcap=none --flows="$n" --scheduler="$scheduler" \
+                --bench=bench.csv "$@" &> LOG || { echo "$scheduler $n failed, see LOG" >&2; exit 1; }
+        ) || continue
+        # rx_bytes has to be the same for every scheduler of a flow count
+        awk -F, -v s="$scheduler" -v n="$n" '
+FNR > 1 { v[$2] = $3 }
+END {
+    print s "," n "," v["events"] "," v["wall_s"] "," v["events_per_s"] "," \
+        v["peak_pending_events"] "," v["max_rss_kb"] "," v["rx_bytes"]
+}' "$dir/bench.csv" | tee -a "$out"
+    done
+done
+echo "Results in $out"
@@ -0,0 +1,40 @@
+#!/bin/bash
+# Merge the per-rank outputs of a distributed run of scratch/network.
+#
+# Every rank writes its files with an r<rank>- prefix. The byte counters,
+# goodputs and retransmission counters of r*-summary.csv are summed into
+# summary.csv (each sink and sender is only counted by its own rank, the
+# other columns are the same on every rank). Packet captures and flow traces are named after their node and
+# need no merging; FlowMonitor outputs stay per rank, since a monitor only
+# sees the packets of its own rank.
+#
+# Usage: merge-ranks.sh [DIR] [SUMMARY]
+
+dir=${1:-.}
+summary=${2:-summary.csv}
+
+files=$(ls "$dir"/r*-"$summary" 2>/dev/null)
+if [ -z "$files" ]
+then
+    echo "No r*-$summary in $dir" >&2
+    exit 1
+fi
+
+# rxBytes, goodputKbps and bgRxBytes are columns 5 to 7, retransmitted
+# and redundant 10 and 11
+awk -F, -v OFS=, '
+FNR == 1 { header = $0; next }
+{
+    if (!seen) { row = $0; seen = 1 }
+    for (c = 5; c <= 11; c++) if (c <= 7 || c >= 10) sum[c] += $c
+}
+END {
+    print header
+    n = split (row, out, ",")
+    for (c = 5; c <= 11; c++) if (c <= 7 || c >= 10) out[c] = sum[c]
+    line = out[1]
+    for (c = 2; c <= n; c++) line = line OFS out[c]
+    print line
+}' $files > "$dir/$summary"
+
+echo "Merged $(echo "$files" | wc -l) ranks into $dir/$summary"
@@ -0,0 +1,258 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bounded-pcap-capture.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+
+#include <cstring>
+#include <set>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BoundedPcapCapture");
+
+NS_OBJECT_ENSURE_REGISTERED (BoundedPcapCapture);
+
+namespace {
+
+/// pcap link type of PPP frames, see http://www.tcpdump.org/linktypes.html
+const uint32_t PCAP_LINKTYPE_PPP = 9;
+
+void
+PutUint32 (uint8_t *p, uint32_t v)
+{
+  std::memcpy (p, &v, sizeof (v));
+}
+
+/// Live captures, for CompressAll
+std::set<BoundedPcapCapture *> &
+Captures (void)
+{
+  static std::set<BoundedPcapCapture *> captures;
+  return captures;
+}
+
+} // anonymous namespace
+
+TypeId
+BoundedPcapCapture::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BoundedPcapCapture")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<BoundedPcapCapture> ()
+    .AddAttribute ("SnapLen",
+                   "Bytes kept from the start of each packet",
+                   UintegerValue (96),
+                   MakeUintegerAccessor (&BoundedPcapCapture::m_snapLen),
+                   MakeUintegerChecker<uint32_t> (1, 65535))
+    .AddAttribute ("StartTime",
+                   "Time at which the capture starts",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&BoundedPcapCapture::m_startTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("StopTime",
+                   "Time at which the capture stops, zero to capture until the end",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&BoundedPcapCapture::m_stopTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxFileSize",
+                   "Bytes of capture written to a file before starting the next one",
+                   UintegerValue (16 * 1024 * 1024),
+                   MakeUintegerAccessor (&BoundedPcapCapture::m_maxFileSize),
+                   MakeUintegerChecker<uint64_t> (1024))
+    .AddAttribute ("Compress",
+                   "Compress the files with gzip in CompressAll, once the run is over",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&BoundedPcapCapture::m_compress),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+BoundedPcapCapture::BoundedPcapCapture ()
+  : m_file (0),
+    m_fileSize (0),
+    m_fileIndex (0)
+{
+  NS_LOG_FUNCTION (this);
+  Captures ().insert (this);
+}
+
+BoundedPcapCapture::~BoundedPcapCapture ()
+{
+  NS_LOG_FUNCTION (this);
+  CloseFile ();
+  Captures ().erase (this);
+}
+
+void
+BoundedPcapCapture::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  CloseFile ();
+  m_device = 0;
+  Object::DoDispose ();
+}
+
+void
+BoundedPcapCapture::Install (Ptr<NetDevice> device, const std::string &prefix)
+{
+  Install (device, prefix, m_startTime, m_stopTime);
+}
+
+void
+BoundedPcapCapture::Install (Ptr<NetDevice> device, const std::string &prefix, Time startTime, Time stopTime)
+{
+  NS_LOG_FUNCTION (this << device << prefix << startTime << stopTime);
+  m_device = device;
+  m_prefix = prefix;
+  m_buffer.resize (16 + m_snapLen);
+
+  Time now = Simulator::Now ();
+  if (!stopTime.IsZero () && stopTime <= now)
+    {
+      return;
+    }
+  // Connecting only for the window keeps the cost outside of it at zero.
+  Simulator::Schedule (Max (startTime - now, Seconds (0)), &BoundedPcapCapture::Start, this);
+  if (!stopTime.IsZero ())
+    {
+      Simulator::Schedule (stopTime - now, &BoundedPcapCapture::Stop, this);
+    }
+}
+
+void
+BoundedPcapCapture::Restart (const std::string &prefix)
+{
+  NS_LOG_FUNCTION (this << prefix);
+  // the files so far belong to the parent, which compresses them
+  if (m_file != 0)
+    {
+      std::fclose (m_file);
+      m_file = 0;
+    }
+  m_closedFiles.clear ();
+  m_prefix = prefix;
+  m_fileIndex = 0;
+}
+
+void
+BoundedPcapCapture::CompressAll (void)
+{
+  std::vector<std::string> files;
+  for (std::set<BoundedPcapCapture *>::const_iterator i = Captures ().begin (); i != Captures ().end (); ++i)
+    {
+      (*i)->CloseFile ();
+      files.insert (files.end (), (*i)->m_closedFiles.begin (), (*i)->m_closedFiles.end ());
+      (*i)->m_closedFiles.clear ();
+    }
+  if (files.empty ())
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("Compressing " << files.size () << " capture files");
+  std::fflush (0);
+  FILE *pipe = popen ("xargs -0 gzip -f --", "w");
+  NS_ABORT_MSG_IF (pipe == 0, "Cannot run gzip on the capture files");
+  for (std::vector<std::string>::const_iterator i = files.begin (); i != files.end (); ++i)
+    {
+      std::fwrite (i->c_str (), i->size () + 1, 1, pipe);
+    }
+  NS_ABORT_MSG_UNLESS (pclose (pipe) == 0, "gzip failed on the capture files");
+}
+
+void
+BoundedPcapCapture::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_device->TraceConnectWithoutContext ("PromiscSniffer", MakeCallback (&BoundedPcapCapture::Capture, this));
+}
+
+void
+BoundedPcapCapture::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_device->TraceDisconnectWithoutContext ("PromiscSniffer", MakeCallback (&BoundedPcapCapture::Capture, this));
+  CloseFile ();
+}
+
+void
+BoundedPcapCapture::OpenFile (void)
+{
+  std::ostringstream fileName;
+  fileName << m_prefix << "-" << m_fileIndex++ << ".pcap";
+  m_fileName = fileName.str ();
+  m_file = std::fopen (m_fileName.c_str (), "wb");
+  NS_ABORT_MSG_IF (m_file == 0, "Cannot open capture file " << m_fileName);
+  NS_LOG_LOGIC ("Capturing into " << m_fileName);
+
+  // pcap file header: magic, version 2.4, GMT offset, accuracy, snaplen, link type
+  uint8_t header[24];
+  PutUint32 (header, 0xa1b2c3d4);
+  uint16_t version[2] = { 2, 4 };
+  std::memcpy (header + 4, version, sizeof (version));
+  PutUint32 (header + 8, 0);
+  PutUint32 (header + 12, 0);
+  PutUint32 (header + 16, m_snapLen);
+  PutUint32 (header + 20, PCAP_LINKTYPE_PPP);
+  std::fwrite (header, sizeof (header), 1, m_file);
+  m_fileSize = sizeof (header);
+}
+
+void
+BoundedPcapCapture::CloseFile (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  std::fclose (m_file);
+  m_file = 0;
+  if (m_compress)
+    {
+      m_closedFiles.push_back (m_fileName);
+    }
+}
+
+void
+BoundedPcapCapture::Capture (Ptr<const Packet> packet)
+{
+  if (m_file != 0 && m_fileSize + m_buffer.size () > m_maxFileSize)
+    {
+      CloseFile ();
+    }
+  if (m_file == 0)
+    {
+      OpenFile ();
+    }
+
+  uint32_t length = packet->CopyData (&m_buffer[16], m_snapLen);
+  int64_t us = Simulator::Now ().GetMicroSeconds ();
+  PutUint32 (&m_buffer[0], static_cast<uint32_t> (us / 1000000));
+  PutUint32 (&m_buffer[4], static_cast<uint32_t> (us % 1000000));
+  PutUint32 (&m_buffer[8], length);
+  PutUint32 (&m_buffer[12], packet->GetSize ());
+  std::fwrite (&m_buffer[0], 16 + length, 1, m_file);
+  m_fileSize += 16 + length;
+}
+
+} // namespace ns3
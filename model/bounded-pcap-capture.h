@@ -0,0 +1,131 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BOUNDED_PCAP_CAPTURE_H
+#define BOUNDED_PCAP_CAPTURE_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/net-device.h"
+#include "ns3/packet.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Pcap capture of one device with a bounded cost
+ *
+ * Only the first SnapLen bytes of each packet are stored (the PPP, IP and
+ * TCP headers with the default value), only within a window of time given
+ * to Install (StartTime and StopTime by default). A new file is started
+ * once MaxFileSize bytes of capture have been written, so files are named
+ * <prefix>-<index>.pcap.
+ *
+ * Files are written uncompressed. With Compress, CompressAll gzips the
+ * files of every capture in one go once the run is over, instead of one
+ * gzip process per captured device running along with the simulation.
+ *
+ * The capture is attached to the "PromiscSniffer" trace source of the
+ * device, which has to carry PPP frames (e.g. PointToPointNetDevice).
+ */
+class BoundedPcapCapture : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BoundedPcapCapture ();
+  virtual ~BoundedPcapCapture ();
+
+  /**
+   * \brief Capture the packets of a device between StartTime and StopTime
+   * \param device the device to capture
+   * \param prefix prefix of the capture file names
+   */
+  void Install (Ptr<NetDevice> device, const std::string &prefix);
+
+  /**
+   * \brief Capture the packets of a device within a window of time
+   * \param device the device to capture
+   * \param prefix prefix of the capture file names
+   * \param startTime start of the capture, now if already past
+   * \param stopTime end of the capture, zero to capture until the end
+   */
+  void Install (Ptr<NetDevice> device, const std::string &prefix, Time startTime, Time stopTime);
+
+  /**
+   * \brief Continue the capture in a new series of files
+   * \param prefix prefix of the new file names
+   *
+   * Used by forked processes, which must not write to or compress the
+   * files of their parent. The stdio buffers have to be flushed before
+   * forking.
+   */
+  void Restart (const std::string &prefix);
+
+  /**
+   * \brief Close the files of every capture and gzip those with Compress
+   *
+   * Called once the simulation is over, runs a single xargs and gzip
+   * pipeline for all the files.
+   */
+  static void CompressAll (void);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Connect to the device trace source
+  void Start (void);
+  /// Disconnect from the device trace source and close the file
+  void Stop (void);
+  /// Open the next file of the rotation and write the pcap file header
+  void OpenFile (void);
+  /// Close the current file, to be compressed by CompressAll with Compress
+  void CloseFile (void);
+  /**
+   * \brief Write one truncated packet record
+   * \param packet the captured packet
+   */
+  void Capture (Ptr<const Packet> packet);
+
+  uint32_t             m_snapLen;     //!< Bytes kept per packet
+  Time                 m_startTime;   //!< Start of the capture window
+  Time                 m_stopTime;    //!< End of the capture window
+  uint64_t             m_maxFileSize; //!< Bytes per file before rotation
+  bool                 m_compress;    //!< gzip the files in CompressAll
+
+  Ptr<NetDevice>       m_device;      //!< Captured device
+  std::string          m_prefix;      //!< File name prefix
+  FILE                *m_file;        //!< Current file
+  std::string          m_fileName;    //!< Name of the current file
+  std::vector<std::string> m_closedFiles; //!< Files to compress
+  uint64_t             m_fileSize;    //!< Bytes written to the current file
+  uint32_t             m_fileIndex;   //!< Index of the current file
+  std::vector<uint8_t> m_buffer;      //!< Record being written
+};
+
+} // namespace ns3
+
+#endif /* BOUNDED_PCAP_CAPTURE_H */
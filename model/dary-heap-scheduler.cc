@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "dary-heap-scheduler.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DaryHeapScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (DaryHeapScheduler);
+
+TypeId
+DaryHeapScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DaryHeapScheduler")
+    .SetParent<Scheduler> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<DaryHeapScheduler> ()
+  ;
+  return tid;
+}
+
+DaryHeapScheduler::DaryHeapScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DaryHeapScheduler::~DaryHeapScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DaryHeapScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  m_heap.push_back (ev);
+  SiftUp (m_heap.size () - 1);
+}
+
+bool
+DaryHeapScheduler::IsEmpty (void) const
+{
+  return m_heap.empty ();
+}
+
+Scheduler::Event
+DaryHeapScheduler::PeekNext (void) const
+{
+  NS_ASSERT (!m_heap.empty ());
+  return m_heap.front ();
+}
+
+Scheduler::Event
+DaryHeapScheduler::RemoveNext (void)
+{
+  NS_ASSERT (!m_heap.empty ());
+  Event next = m_heap.front ();
+  RemoveAt (0);
+  NS_LOG_FUNCTION (this << next.impl << next.key.m_ts << next.key.m_uid);
+  return next;
+}
+
+void
+DaryHeapScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  // uids are unique, the timestamp only saves comparing most of them
+  for (size_t i = 0; i < m_heap.size (); i++)
+    {
+      if (m_heap[i].key.m_uid == ev.key.m_uid && m_heap[i].key.m_ts == ev.key.m_ts)
+        {
+          NS_ASSERT (m_heap[i].impl == ev.impl);
+          RemoveAt (i);
+          return;
+        }
+    }
+  NS_ABORT_MSG ("Removing an event that is not scheduled");
+}
+
+void
+DaryHeapScheduler::RemoveAt (size_t index)
+{
+  size_t last = m_heap.size () - 1;
+  if (index != last)
+    {
+      m_heap[index] = m_heap[last];
+      m_heap.pop_back ();
+      if (index > 0 && m_heap[index].key < m_heap[(index - 1) / ARITY].key)
+        {
+          SiftUp (index);
+        }
+      else
+        {
+          SiftDown (index);
+        }
+    }
+  else
+    {
+      m_heap.pop_back ();
+    }
+}
+
+void
+DaryHeapScheduler::SiftUp (size_t index)
+{
+  // hole insertion: the event is written once, at its final place
+  Event ev = m_heap[index];
+  while (index > 0)
+    {
+      size_t parent = (index - 1) / ARITY;
+      if (!(ev.key < m_heap[parent].key))
+        {
+          break;
+        }
+      m_heap[index] = m_heap[parent];
+      index = parent;
+    }
+  m_heap[index] = ev;
+}
+
+void
+DaryHeapScheduler::SiftDown (size_t index)
+{
+  size_t size = m_heap.size ();
+  Event ev = m_heap[index];
+  while (true)
+    {
+      size_t first = index * ARITY + 1;
+      if (first >= size)
+        {
+          break;
+        }
+      size_t end = first + ARITY < size ? first + ARITY : size;
+      size_t earliest = first;
+      for (size_t child = first + 1; child < end; child++)
+        {
+          if (m_heap[child].key < m_heap[earliest].key)
+            {
+              earliest = child;
+            }
+        }
+      if (!(m_heap[earliest].key < ev.key))
+        {
+          break;
+        }
+      m_heap[index] = m_heap[earliest];
+      index = earliest;
+    }
+  m_heap[index] = ev;
+}
+
+} // namespace ns3
@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef DARY_HEAP_SCHEDULER_H
+#define DARY_HEAP_SCHEDULER_H
+
+#include "ns3/scheduler.h"
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Event scheduler using a 4-ary heap stored by value in one array
+ *
+ * The events are kept in a std::vector, so a sift step compares four
+ * children lying in one or two cache lines instead of following map or
+ * list nodes, and inserting does not allocate once the array has grown.
+ * A 4-ary heap is half as deep as the binary heap of HeapScheduler, for
+ * slightly more comparisons per level. Remove searches the array, like
+ * HeapScheduler.
+ *
+ * Selected with the global value SchedulerType or Simulator::SetScheduler.
+ */
+class DaryHeapScheduler : public Scheduler
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  DaryHeapScheduler ();
+  virtual ~DaryHeapScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  /// Children per node
+  static const size_t ARITY = 4;
+
+  /**
+   * \brief Move the event at an index towards the root until its parent is earlier
+   * \param index the index of the event
+   */
+  void SiftUp (size_t index);
+  /**
+   * \brief Move the event at an index towards the leaves until its children are later
+   * \param index the index of the event
+   */
+  void SiftDown (size_t index);
+  /**
+   * \brief Remove the event at an index, replacing it with the last one
+   * \param index the index of the event
+   */
+  void RemoveAt (size_t index);
+
+  std::vector<Event> m_heap; //!< Events, the earliest first
+};
+
+} // namespace ns3
+
+#endif /* DARY_HEAP_SCHEDULER_H */
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef FLOW_TRACE_DOWNSAMPLER_H
+#define FLOW_TRACE_DOWNSAMPLER_H
+
+/*
+ * Shape-preserving downsampling of flow traces, shared by the simulator
+ * (TcpTraceBuffer) and the tools in tools/. This header must not depend on
+ * ns-3.
+ */
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace ns3 {
+
+/**
+ * \brief Min/max per time bucket of the cwnd and ssthresh of a flow
+ *
+ * Time is cut in buckets of a fixed width; of all the samples of a bucket,
+ * only those holding the smallest and largest cwnd and ssthresh are kept,
+ * at most four, in time order. Drawn as lines, the result has the same
+ * envelope as the full trace (every peak and every drop of the window
+ * stays) with at most four points per bucket.
+ *
+ * Sample is any type with time, cwnd and ssThresh members (TcpTraceRecord,
+ * FlowTraceSample); samples must be added in time order. Kept samples are
+ * passed to sink (sample), which must be callable with a const Sample &.
+ */
+template <class Sample, class Sink>
+class FlowTraceDownsampler
+{
+public:
+  /**
+   * \param bucket width of the buckets, in nanoseconds; 0 keeps every sample
+   * \param sink receives the kept samples
+   */
+  FlowTraceDownsampler (int64_t bucket, Sink sink)
+    : m_bucket (bucket),
+      m_sink (sink),
+      m_index (0),
+      m_count (0)
+  {
+  }
+
+  /**
+   * \brief Add the next sample of the trace
+   */
+  void Add (const Sample &sample)
+  {
+    if (m_bucket <= 0)
+      {
+        m_sink (sample);
+        return;
+      }
+    int64_t index = sample.time / m_bucket;
+    if (m_count > 0 && index != m_index)
+      {
+        Finish ();
+      }
+    if (m_count == 0)
+      {
+        m_index = index;
+        for (int i = 0; i < EXTREMES; i++)
+          {
+            m_kept[i] = sample;
+            m_order[i] = 0;
+          }
+      }
+    else
+      {
+        Keep (MIN_CWND, sample, sample.cwnd < m_kept[MIN_CWND].cwnd);
+        Keep (MAX_CWND, sample, sample.cwnd > m_kept[MAX_CWND].cwnd);
+        Keep (MIN_SSTHRESH, sample, sample.ssThresh < m_kept[MIN_SSTHRESH].ssThresh);
+        Keep (MAX_SSTHRESH, sample, sample.ssThresh > m_kept[MAX_SSTHRESH].ssThresh);
+      }
+    m_count++;
+  }
+
+  /**
+   * \brief Pass the samples kept in the current bucket to the sink
+   *
+   * Called at the end of the trace; adding samples afterwards starts a new
+   * bucket.
+   */
+  void Finish (void)
+  {
+    if (m_count == 0)
+      {
+        return;
+      }
+    // the order numbers identify the samples: equal ones are the same sample
+    uint32_t order[EXTREMES];
+    std::copy (m_order, m_order + EXTREMES, order);
+    std::sort (order, order + EXTREMES);
+    for (int i = 0; i < EXTREMES; i++)
+      {
+        if (i > 0 && order[i] == order[i - 1])
+          {
+            continue;
+          }
+        for (int j = 0; j < EXTREMES; j++)
+          {
+            if (m_order[j] == order[i])
+              {
+                m_sink (m_kept[j]);
+                break;
+              }
+          }
+      }
+    m_count = 0;
+  }
+
+private:
+  /// Samples kept per bucket
+  enum Extreme
+  {
+    MIN_CWND = 0,
+    MAX_CWND,
+    MIN_SSTHRESH,
+    MAX_SSTHRESH,
+    EXTREMES
+  };
+
+  /// Replace one extreme of the bucket by \p sample if \p better
+  void Keep (int extreme, const Sample &sample, bool better)
+  {
+    if (better)
+      {
+        m_kept[extreme] = sample;
+        m_order[extreme] = m_count;
+      }
+  }
+
+  int64_t  m_bucket;           //!< Bucket width, in nanoseconds
+  Sink     m_sink;             //!< Receives the kept samples
+  int64_t  m_index;            //!< Index of the current bucket
+  uint32_t m_count;            //!< Samples added to the current bucket
+  Sample   m_kept[EXTREMES];   //!< Extremes of the current bucket
+  uint32_t m_order[EXTREMES];  //!< Position of each extreme in the bucket
+};
+
+} // namespace ns3
+
+#endif /* FLOW_TRACE_DOWNSAMPLER_H */
@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_TRACE_FORMAT_H
+#define FLOW_TRACE_FORMAT_H
+
+/*
+ * On-disk format of the per-flow congestion traces, shared by the
+ * simulator (TcpTraceBuffer) and the standalone tools in tools/. This
+ * header must not depend on ns-3.
+ *
+ * A file holds one flow:
+ *
+ *   FlowTraceFileHeader
+ *   block*
+ *
+ * and every block holds up to a few thousand samples stored column by
+ * column, so that a column can be decoded without touching the others:
+ *
+ *   FlowTraceBlockHeader
+ *   time column      count unsigned varints, delta to the previous time (ns)
+ *   cwnd column      count zigzag varints, delta to the previous cwnd
+ *   ssthresh column  count zigzag varints, delta to the previous ssthresh
+ *   event column     count bytes
+ *
+ * Deltas restart from zero in every block, so blocks can be decoded
+ * independently. All integers are little-endian.
+ */
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace ns3 {
+
+/// Magic number at the start of a flow trace file
+static const char FLOW_TRACE_MAGIC[8] = { 'F', 'L', 'O', 'W', 'T', 'R', 'C', '1' };
+
+/**
+ * \brief Header of a flow trace file, identifying the flow
+ */
+struct FlowTraceFileHeader
+{
+  char     magic[8];     //!< FLOW_TRACE_MAGIC
+  uint32_t nodeId;       //!< Id of the node owning the socket
+  uint32_t localAddress; //!< Local IPv4 address, host order
+  uint32_t peerAddress;  //!< Peer IPv4 address, host order
+  uint16_t localPort;    //!< Local port
+  uint16_t peerPort;     //!< Peer port
+  uint8_t  protocol;     //!< IP protocol number, 6 for TCP
+  uint8_t  pad[7];       //!< Padding, always zero
+};
+
+/**
+ * \brief Header of a block of samples
+ */
+struct FlowTraceBlockHeader
+{
+  uint32_t count;         //!< Number of samples in the block
+  uint32_t timeBytes;     //!< Size of the time column
+  uint32_t cwndBytes;     //!< Size of the cwnd column
+  uint32_t ssThreshBytes; //!< Size of the ssthresh column
+};
+
+/**
+ * \brief Append an unsigned LEB128 varint
+ */
+inline void
+FlowTracePutVarint (std::vector<uint8_t> &out, uint64_t v)
+{
+  while (v >= 0x80)
+    {
+      out.push_back (static_cast<uint8_t> (v | 0x80));
+      v >>= 7;
+    }
+  out.push_back (static_cast<uint8_t> (v));
+}
+
+/**
+ * \brief Read an unsigned LEB128 varint
+ * \param p current position, advanced past the varint
+ * \param end end of the readable data
+ * \param v the decoded value
+ * \return false if the data ends in the middle of the varint
+ */
+inline bool
+FlowTraceGetVarint (const uint8_t *&p, const uint8_t *end, uint64_t &v)
+{
+  v = 0;
+  for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+    {
+      uint8_t b = *p++;
+      v |= static_cast<uint64_t> (b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+/**
+ * \brief Map a signed delta to an unsigned value, small magnitudes first
+ */
+inline uint64_t
+FlowTraceZigZag (int64_t v)
+{
+  return (static_cast<uint64_t> (v) << 1) ^ static_cast<uint64_t> (v >> 63);
+}
+
+/**
+ * \brief Inverse of FlowTraceZigZag
+ */
+inline int64_t
+FlowTraceUnZigZag (uint64_t v)
+{
+  return static_cast<int64_t> (v >> 1) ^ -static_cast<int64_t> (v & 1);
+}
+
+} // namespace ns3
+
+#endif /* FLOW_TRACE_FORMAT_H */
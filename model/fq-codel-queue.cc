@@ -0,0 +1,513 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "fq-codel-queue.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("FqCoDelQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (FqCoDelQueue);
+
+namespace {
+
+/// PPP protocol number of IPv4
+const uint16_t PPP_IPV4 = 0x0021;
+
+/// Sojourn times above this many milliseconds share the last histogram bin
+const uint32_t SOJOURN_HIST_MS = 2000;
+
+/// FNV-1a hash of a byte range, continuing from hash
+uint32_t
+Fnv1a (uint32_t hash, const uint8_t *p, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      hash = (hash ^ p[i]) * 16777619u;
+    }
+  return hash;
+}
+
+} // anonymous namespace
+
+TypeId
+FqCoDelQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FqCoDelQueue")
+    .SetParent<Queue> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<FqCoDelQueue> ()
+    .AddAttribute ("Flows",
+                   "Number of flow queues the packets are hashed into, 1 for a single queue",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&FqCoDelQueue::m_nFlows),
+                   MakeUintegerChecker<uint32_t> (1, 65536))
+    .AddAttribute ("MaxPackets",
+                   "Packets held in all the flow queues before dropping",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&FqCoDelQueue::m_maxPackets),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CoDel",
+                   "Drop with the CoDel control law, otherwise only on overflow",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&FqCoDelQueue::m_codel),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Target",
+                   "Sojourn time CoDel keeps the queues at",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&FqCoDelQueue::m_target),
+                   MakeTimeChecker ())
+    .AddAttribute ("Interval",
+                   "Time the sojourn time has to stay above Target before CoDel drops",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&FqCoDelQueue::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("Quantum",
+                   "Bytes a flow queue may send per round",
+                   UintegerValue (1514),
+                   MakeUintegerAccessor (&FqCoDelQueue::m_quantum),
+                   MakeUintegerChecker<uint32_t> (64))
+    .AddAttribute ("Mtu",
+                   "Bytes of backlog below which a flow queue is never dropped from by CoDel",
+                   UintegerValue (1502),
+                   MakeUintegerAccessor (&FqCoDelQueue::m_mtu),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddTraceSource ("Sojourn",
+                     "Time each delivered packet spent in the queue",
+                     MakeTraceSourceAccessor (&FqCoDelQueue::m_sojournTrace),
+                     "ns3::FqCoDelQueue::SojournTracedCallback")
+  ;
+  return tid;
+}
+
+FqCoDelQueue::Flow::Flow ()
+  : bytes (0),
+    deficit (0),
+    list (INACTIVE),
+    count (0),
+    lastCount (0),
+    dropping (false),
+    codelOwed (0),
+    overflowOwed (0),
+    delivered (0)
+{
+}
+
+FqCoDelQueue::FqCoDelQueue ()
+  : m_packets (0),
+    m_bytes (0),
+    m_backlogged (0),
+    m_dequeued (0),
+    m_codelDrops (0),
+    m_overflowDrops (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FqCoDelQueue::~FqCoDelQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+FqCoDelQueue::GetBacklogPackets (void) const
+{
+  return m_packets;
+}
+
+uint32_t
+FqCoDelQueue::GetBacklogBytes (void) const
+{
+  return m_bytes;
+}
+
+uint64_t
+FqCoDelQueue::GetDequeuedPackets (void) const
+{
+  return m_dequeued;
+}
+
+uint64_t
+FqCoDelQueue::GetCoDelDrops (void) const
+{
+  return m_codelDrops;
+}
+
+uint64_t
+FqCoDelQueue::GetOverflowDrops (void) const
+{
+  return m_overflowDrops;
+}
+
+Time
+FqCoDelQueue::GetMeanSojourn (void) const
+{
+  if (m_dequeued == 0)
+    {
+      return Time (0);
+    }
+  return NanoSeconds (m_sojournSum.GetNanoSeconds () / static_cast<int64_t> (m_dequeued));
+}
+
+Time
+FqCoDelQueue::GetMaxSojourn (void) const
+{
+  return m_sojournMax;
+}
+
+Time
+FqCoDelQueue::GetSojournQuantile (double q) const
+{
+  NS_ABORT_MSG_IF (q < 0 || q > 1, "Quantile " << q << " is not between 0 and 1");
+  if (m_dequeued == 0)
+    {
+      return Time (0);
+    }
+  uint64_t rank = static_cast<uint64_t> (std::ceil (q * m_dequeued));
+  uint64_t seen = 0;
+  for (uint32_t ms = 0; ms < m_sojournHist.size (); ms++)
+    {
+      seen += m_sojournHist[ms];
+      if (seen >= rank && seen > 0)
+        {
+          return ms + 1 < SOJOURN_HIST_MS ? MilliSeconds (ms + 1) : m_sojournMax;
+        }
+    }
+  return m_sojournMax;
+}
+
+double
+FqCoDelQueue::GetFairness (void) const
+{
+  double sum = 0;
+  double squares = 0;
+  uint32_t n = 0;
+  for (std::map<uint32_t, Flow>::const_iterator i = m_flows.begin (); i != m_flows.end (); ++i)
+    {
+      if (i->second.delivered > 0)
+        {
+          double x = i->second.delivered;
+          sum += x;
+          squares += x * x;
+          n++;
+        }
+    }
+  return n > 0 ? sum * sum / (n * squares) : 1;
+}
+
+uint32_t
+FqCoDelQueue::GetActiveFlows (void) const
+{
+  uint32_t n = 0;
+  for (std::map<uint32_t, Flow>::const_iterator i = m_flows.begin (); i != m_flows.end (); ++i)
+    {
+      if (i->second.delivered > 0)
+        {
+          n++;
+        }
+    }
+  return n;
+}
+
+uint32_t
+FqCoDelQueue::Classify (Ptr<const Packet> p) const
+{
+  if (m_nFlows == 1)
+    {
+      return 0;
+    }
+
+  // PPP protocol, the IPv4 header and the first 4 bytes of the transport
+  // header, without options in the IPv4 header
+  uint8_t buffer[2 + 20 + 4];
+  uint32_t length = p->CopyData (buffer, sizeof (buffer));
+  if (length < 2 + 20 || ((buffer[0] << 8) | buffer[1]) != PPP_IPV4)
+    {
+      return 0;
+    }
+  const uint8_t *ip = buffer + 2;
+  uint32_t hash = 2166136261u;
+  hash = Fnv1a (hash, ip + 9, 1);   // protocol
+  hash = Fnv1a (hash, ip + 12, 8);  // source and destination addresses
+  uint8_t protocol = ip[9];
+  uint32_t headerLength = (ip[0] & 0x0f) * 4;
+  if ((protocol == 6 || protocol == 17) && headerLength == 20 && length == sizeof (buffer))
+    {
+      hash = Fnv1a (hash, ip + 20, 4); // source and destination ports
+    }
+  return hash % m_nFlows;
+}
+
+bool
+FqCoDelQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  if (m_sojournHist.empty ())
+    {
+      m_sojournHist.resize (SOJOURN_HIST_MS);
+    }
+
+  uint32_t index = Classify (p);
+  Flow &flow = m_flows[index];
+  if (m_packets >= m_maxPackets)
+    {
+      // A flow queue below its share of the limit keeps its packet, and
+      // the fattest one loses its next packet instead (RFC 8290).
+      uint32_t flows = m_backlogged + (flow.items.empty () ? 1 : 0);
+      Flow &fattest = GetFattestFlow ();
+      if (flow.items.size () * flows >= m_maxPackets || &fattest == &flow || m_packets >= 2 * m_maxPackets)
+        {
+          NS_LOG_LOGIC ("Queue full, dropping " << p);
+          return Refuse (p, m_overflowDrops);
+        }
+      NS_LOG_LOGIC ("Queue full, the fattest flow queue drops its next packet for " << p);
+      fattest.overflowOwed++;
+    }
+  // The owed drops are taken from packets which would have been queued,
+  // so that each of them leaves the flow queue one packet shorter.
+  else if (flow.codelOwed > 0)
+    {
+      NS_LOG_LOGIC ("CoDel dropping " << p << " of flow queue " << index);
+      flow.codelOwed--;
+      return Refuse (p, m_codelDrops);
+    }
+  else if (flow.overflowOwed > 0)
+    {
+      NS_LOG_LOGIC ("Dropping " << p << " for an earlier overflow of flow queue " << index);
+      flow.overflowOwed--;
+      return Refuse (p, m_overflowDrops);
+    }
+
+  Item item;
+  item.packet = p;
+  item.enqueued = Simulator::Now ();
+  if (flow.items.empty ())
+    {
+      m_backlogged++;
+    }
+  flow.items.push_back (item);
+  flow.bytes += p->GetSize ();
+  m_packets++;
+  m_bytes += p->GetSize ();
+  if (flow.list == INACTIVE)
+    {
+      flow.list = NEW_FLOWS;
+      flow.deficit = m_quantum;
+      m_newFlows.push_back (index);
+    }
+  return true;
+}
+
+bool
+FqCoDelQueue::Refuse (Ptr<Packet> p, uint64_t &drops)
+{
+  drops++;
+  Drop (p);
+  return false;
+}
+
+FqCoDelQueue::Flow &
+FqCoDelQueue::GetFattestFlow (void)
+{
+  std::map<uint32_t, Flow>::iterator fattest = m_flows.begin ();
+  for (std::map<uint32_t, Flow>::iterator i = m_flows.begin (); i != m_flows.end (); ++i)
+    {
+      if (i->second.bytes > fattest->second.bytes)
+        {
+          fattest = i;
+        }
+    }
+  return fattest->second;
+}
+
+Ptr<Packet>
+FqCoDelQueue::PopHead (Flow &flow, Time now, bool &okToDrop, Time &sojourn)
+{
+  okToDrop = false;
+  Item item = flow.items.front ();
+  flow.items.pop_front ();
+  flow.bytes -= item.packet->GetSize ();
+  m_packets--;
+  m_bytes -= item.packet->GetSize ();
+  if (flow.items.empty ())
+    {
+      // no drop is needed to drain a queue which already did
+      m_backlogged--;
+      flow.codelOwed = 0;
+      flow.overflowOwed = 0;
+    }
+
+  sojourn = now - item.enqueued;
+  if (!m_codel || sojourn < m_target || flow.bytes <= m_mtu)
+    {
+      flow.firstAboveTime = Time (0);
+    }
+  else if (flow.firstAboveTime.IsZero ())
+    {
+      flow.firstAboveTime = now + m_interval;
+    }
+  else if (now >= flow.firstAboveTime)
+    {
+      okToDrop = true;
+    }
+  return item.packet;
+}
+
+Ptr<Packet>
+FqCoDelQueue::CoDelDequeue (Flow &flow)
+{
+  if (flow.items.empty ())
+    {
+      flow.firstAboveTime = Time (0);
+      return 0;
+    }
+  Time now = Simulator::Now ();
+  bool okToDrop;
+  Time sojourn;
+  Ptr<Packet> p = PopHead (flow, now, okToDrop, sojourn);
+
+  // RFC 8289 section 5.5: in the dropping state, drop at the times given
+  // by the control law, interval / sqrt (count) apart, until the sojourn
+  // time goes back below the target. The drops are owed by the flow queue
+  // and taken from its next arrivals rather than from its head.
+  if (flow.dropping)
+    {
+      if (!okToDrop)
+        {
+          flow.dropping = false;
+        }
+      while (flow.dropping && now >= flow.dropNext)
+        {
+          flow.codelOwed++;
+          flow.count++;
+          flow.dropNext += NanoSeconds (static_cast<int64_t> (m_interval.GetNanoSeconds () / std::sqrt (flow.count)));
+        }
+    }
+  else if (okToDrop)
+    {
+      NS_LOG_LOGIC ("CoDel entering the dropping state");
+      flow.codelOwed++;
+      flow.dropping = true;
+      // Start again from the drop rate of the last dropping state if it
+      // ended recently, as the queue has not drained since.
+      uint32_t delta = flow.count - flow.lastCount;
+      flow.count = (delta > 1 && now - flow.dropNext < NanoSeconds (16 * m_interval.GetNanoSeconds ())) ? delta : 1;
+      flow.dropNext = now + NanoSeconds (static_cast<int64_t> (m_interval.GetNanoSeconds () / std::sqrt (flow.count)));
+      flow.lastCount = flow.count;
+    }
+  if (flow.items.empty ())
+    {
+      flow.codelOwed = 0;
+    }
+
+  RecordSojourn (sojourn);
+  return p;
+}
+
+void
+FqCoDelQueue::RecordSojourn (Time sojourn)
+{
+  m_dequeued++;
+  m_sojournSum += sojourn;
+  if (sojourn > m_sojournMax)
+    {
+      m_sojournMax = sojourn;
+    }
+  uint64_t ms = sojourn.GetNanoSeconds () / 1000000;
+  m_sojournHist[ms < SOJOURN_HIST_MS ? ms : SOJOURN_HIST_MS - 1]++;
+  m_sojournTrace (sojourn);
+}
+
+Ptr<Packet>
+FqCoDelQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Deficit round robin, new flow queues first (RFC 8290 section 4.2)
+  while (!m_newFlows.empty () || !m_oldFlows.empty ())
+    {
+      bool isNew = !m_newFlows.empty ();
+      std::list<uint32_t> &list = isNew ? m_newFlows : m_oldFlows;
+      uint32_t index = list.front ();
+      Flow &flow = m_flows[index];
+
+      if (flow.deficit <= 0)
+        {
+          flow.deficit += m_quantum;
+          list.pop_front ();
+          flow.list = OLD_FLOWS;
+          m_oldFlows.push_back (index);
+          continue;
+        }
+
+      Ptr<Packet> p = CoDelDequeue (flow);
+      if (p == 0)
+        {
+          // A new flow queue which went empty goes through the old ones
+          // once, so that a flow cannot stay new by sending one packet
+          // per round.
+          list.pop_front ();
+          if (isNew && !m_oldFlows.empty ())
+            {
+              flow.list = OLD_FLOWS;
+              m_oldFlows.push_back (index);
+            }
+          else
+            {
+              flow.list = INACTIVE;
+            }
+          continue;
+        }
+
+      flow.deficit -= p->GetSize ();
+      flow.delivered += p->GetSize ();
+      return p;
+    }
+  return 0;
+}
+
+Ptr<const Packet>
+FqCoDelQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+  for (std::list<uint32_t>::const_iterator i = m_newFlows.begin (); i != m_newFlows.end (); ++i)
+    {
+      const Flow &flow = m_flows.find (*i)->second;
+      if (!flow.items.empty ())
+        {
+          return flow.items.front ().packet;
+        }
+    }
+  for (std::list<uint32_t>::const_iterator i = m_oldFlows.begin (); i != m_oldFlows.end (); ++i)
+    {
+      const Flow &flow = m_flows.find (*i)->second;
+      if (!flow.items.empty ())
+        {
+          return flow.items.front ().packet;
+        }
+    }
+  return 0;
+}
+
+} // namespace ns3
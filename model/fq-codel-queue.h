@@ -0,0 +1,219 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FQ_CODEL_QUEUE_H
+#define FQ_CODEL_QUEUE_H
+
+#include "ns3/queue.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/traced-callback.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Flow-hashed fair queue with CoDel dropping, for point-to-point devices
+ *
+ * Packets are hashed on their IPv4 addresses, protocol and ports into one
+ * of Flows queues, served by deficit round robin with new flows first
+ * (RFC 8290). Each queue drops with the CoDel control law (RFC 8289) once
+ * its packets have waited more than Target for at least Interval. The
+ * state of a flow queue is created with its first packet.
+ *
+ * Every drop is the refusal of an arriving packet, the only drop
+ * ns3::Queue keeps GetNPackets, GetNBytes and IsEmpty exact for. CoDel
+ * decides its drops when dequeuing, at the times given by the control law,
+ * and the flow queue pays them with its next arriving packets. On overflow
+ * the arriving packet is refused, unless its flow queue holds less than
+ * its share of MaxPackets: it is then queued above the limit, and the
+ * fattest flow queue refuses its next packet instead (RFC 8290 drops from
+ * the fattest queue). Drops still owed when a flow queue empties are
+ * forgiven. The queue never holds more than twice MaxPackets.
+ *
+ * With Flows = 1 there is a single CoDel queue, and with CoDel = false the
+ * queues only drop on overflow: Flows = 1 and CoDel = false is a drop-tail
+ * FIFO, the default of PointToPointNetDevice, with the statistics below.
+ *
+ * The time every delivered packet spent in the queue (its sojourn time) is
+ * reported by the "Sojourn" trace source and summed up by the Get* methods.
+ *
+ * The packets are expected to start with a PPP header, as they do when
+ * PointToPointNetDevice queues them. Peek only returns the head of the
+ * first flow queue: the packet Dequeue returns may differ, when the round
+ * robin moves on to another flow queue.
+ */
+class FqCoDelQueue : public Queue
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  FqCoDelQueue ();
+  virtual ~FqCoDelQueue ();
+
+  /// \return the packets in the queue, as GetNPackets
+  uint32_t GetBacklogPackets (void) const;
+  /// \return the bytes in the queue, as GetNBytes
+  uint32_t GetBacklogBytes (void) const;
+
+  /// \return the packets delivered by Dequeue
+  uint64_t GetDequeuedPackets (void) const;
+  /// \return the packets refused for the CoDel control law
+  uint64_t GetCoDelDrops (void) const;
+  /// \return the packets refused because the queue was full
+  uint64_t GetOverflowDrops (void) const;
+
+  /// \return the mean sojourn time of the delivered packets
+  Time GetMeanSojourn (void) const;
+  /// \return the largest sojourn time of a delivered packet
+  Time GetMaxSojourn (void) const;
+  /**
+   * \brief Quantile of the sojourn times, to the millisecond
+   * \param q quantile, between 0 and 1
+   * \return the upper bound of the millisecond holding the quantile
+   */
+  Time GetSojournQuantile (double q) const;
+
+  /**
+   * \brief Jain's fairness index of the bytes delivered per flow queue
+   * \return 1 when the active queues got the same share, down to
+   *         1/n when one of n queues got everything
+   */
+  double GetFairness (void) const;
+  /// \return the number of flow queues which delivered at least one packet
+  uint32_t GetActiveFlows (void) const;
+
+  /**
+   * TracedCallback signature of the sojourn times.
+   * \param [in] sojourn time the delivered packet spent in the queue
+   */
+  typedef void (* SojournTracedCallback)(Time sojourn);
+
+private:
+  virtual bool DoEnqueue (Ptr<Packet> p);
+  virtual Ptr<Packet> DoDequeue (void);
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+  /// Packet and the time it entered the queue
+  struct Item
+  {
+    Ptr<Packet> packet;   //!< Queued packet
+    Time        enqueued; //!< Time of the enqueue
+  };
+
+  /// List a flow queue is on
+  enum FlowList
+  {
+    INACTIVE,
+    NEW_FLOWS,
+    OLD_FLOWS
+  };
+
+  /// One flow queue and its CoDel state
+  struct Flow
+  {
+    Flow ();
+
+    std::deque<Item> items;          //!< Queued packets
+    uint32_t         bytes;          //!< Bytes queued
+    int32_t          deficit;        //!< DRR deficit, in bytes
+    FlowList         list;           //!< List the flow is on
+    Time             firstAboveTime; //!< When the sojourn time may turn too long, zero if below Target
+    Time             dropNext;       //!< Next drop while dropping
+    uint32_t         count;          //!< Drops since entering the dropping state
+    uint32_t         lastCount;      //!< count when the last dropping state was entered
+    bool             dropping;       //!< In the dropping state
+    uint32_t         codelOwed;      //!< CoDel drops to take from the next arrivals
+    uint32_t         overflowOwed;   //!< Overflow drops to take from the next arrivals
+    uint64_t         delivered;      //!< Bytes delivered, for GetFairness
+  };
+
+  /**
+   * \brief Index of the flow queue of a packet
+   * \param p packet starting with a PPP header
+   * \return the flow queue index
+   */
+  uint32_t Classify (Ptr<const Packet> p) const;
+
+  /**
+   * \brief Remove the head of a flow queue and check its sojourn time
+   * \param flow the flow queue, not empty
+   * \param now current time
+   * \param okToDrop receives whether CoDel may drop
+   * \param sojourn receives the time the packet spent in the queue
+   * \return the packet
+   */
+  Ptr<Packet> PopHead (Flow &flow, Time now, bool &okToDrop, Time &sojourn);
+
+  /**
+   * \brief Dequeue from a flow queue, running the CoDel control law
+   * \param flow the flow queue
+   * \return the packet to deliver, or 0 if the flow queue is empty
+   */
+  Ptr<Packet> CoDelDequeue (Flow &flow);
+
+  /**
+   * \brief Refuse an arriving packet
+   * \param p the packet
+   * \param drops the drop counter to increment
+   * \return false, for DoEnqueue
+   */
+  bool Refuse (Ptr<Packet> p, uint64_t &drops);
+
+  /// \return the flow queue holding the most bytes
+  Flow & GetFattestFlow (void);
+
+  /// Account the sojourn time of a delivered packet
+  void RecordSojourn (Time sojourn);
+
+  uint32_t m_nFlows;     //!< Number of flow queues
+  uint32_t m_maxPackets; //!< Packets held before dropping
+  bool     m_codel;      //!< Drop with the CoDel control law
+  Time     m_target;     //!< CoDel target sojourn time
+  Time     m_interval;   //!< CoDel interval
+  uint32_t m_quantum;    //!< DRR quantum, in bytes
+  uint32_t m_mtu;        //!< Backlog below which CoDel does not drop, in bytes
+
+  std::map<uint32_t, Flow> m_flows;  //!< Flow queues by index, created by their first packet
+  std::list<uint32_t>  m_newFlows;   //!< Flow queues served first
+  std::list<uint32_t>  m_oldFlows;   //!< Flow queues served after the new ones
+  uint32_t             m_packets;    //!< Packets in all the flow queues
+  uint32_t             m_bytes;      //!< Bytes in all the flow queues
+  uint32_t             m_backlogged; //!< Flow queues holding packets
+
+  uint64_t              m_dequeued;      //!< Packets delivered
+  uint64_t              m_codelDrops;    //!< Packets dropped by CoDel
+  uint64_t              m_overflowDrops; //!< Packets dropped on overflow
+  Time                  m_sojournSum;    //!< Sum of the sojourn times
+  Time                  m_sojournMax;    //!< Largest sojourn time
+  std::vector<uint64_t> m_sojournHist;   //!< Delivered packets per millisecond of sojourn
+
+  TracedCallback<Time> m_sojournTrace; //!< Sojourn time of each delivered packet
+};
+
+} // namespace ns3
+
+#endif /* FQ_CODEL_QUEUE_H */
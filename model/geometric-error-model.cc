@@ -0,0 +1,225 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "geometric-error-model.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/pointer.h"
+#include "ns3/string.h"
+#include "ns3/packet.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GeometricErrorModel");
+
+NS_OBJECT_ENSURE_REGISTERED (GeometricErrorModel);
+
+TypeId
+GeometricErrorModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::GeometricErrorModel")
+    .SetParent<ErrorModel> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<GeometricErrorModel> ()
+    .AddAttribute ("ErrorUnit",
+                   "Unit of the error rates",
+                   EnumValue (ERROR_UNIT_BYTE),
+                   MakeEnumAccessor (&GeometricErrorModel::m_unit),
+                   MakeEnumChecker (ERROR_UNIT_BIT, "ERROR_UNIT_BIT",
+                                    ERROR_UNIT_BYTE, "ERROR_UNIT_BYTE",
+                                    ERROR_UNIT_PACKET, "ERROR_UNIT_PACKET"))
+    .AddAttribute ("ErrorRate",
+                   "Probability of corrupting a unit, in the good state in Gilbert-Elliott mode",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&GeometricErrorModel::m_rate),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("GilbertElliott",
+                   "Alternate between a good and a bad state",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&GeometricErrorModel::m_burst),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BadErrorRate",
+                   "Probability of corrupting a unit in the bad state",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&GeometricErrorModel::m_badRate),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("GoodToBad",
+                   "Probability of entering the bad state after a unit in the good state",
+                   DoubleValue (1e-6),
+                   MakeDoubleAccessor (&GeometricErrorModel::m_goodToBad),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("BadToGood",
+                   "Probability of leaving the bad state after a unit in the bad state",
+                   DoubleValue (1e-3),
+                   MakeDoubleAccessor (&GeometricErrorModel::m_badToGood),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("RanVar", "The decision variable attached to this error model.",
+                   StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=1.0]"),
+                   MakePointerAccessor (&GeometricErrorModel::m_ranvar),
+                   MakePointerChecker<RandomVariableStream> ())
+  ;
+  return tid;
+}
+
+GeometricErrorModel::GeometricErrorModel ()
+  : m_started (false),
+    m_bad (false),
+    m_skip (0),
+    m_stateLeft (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+GeometricErrorModel::~GeometricErrorModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+int64_t
+GeometricErrorModel::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_ranvar->SetStream (stream);
+  return 1;
+}
+
+uint64_t
+GeometricErrorModel::DrawGeometric (double p)
+{
+  if (p <= 0)
+    {
+      return std::numeric_limits<uint64_t>::max ();
+    }
+  if (p >= 1)
+    {
+      return 0;
+    }
+  // inversion of the geometric distribution, u in (0, 1]
+  double u = 1.0 - m_ranvar->GetValue ();
+  if (u <= 0)
+    {
+      u = std::numeric_limits<double>::min ();
+    }
+  double failures = std::floor (std::log (u) / log1p (-p));
+  if (failures >= static_cast<double> (std::numeric_limits<uint64_t>::max ()))
+    {
+      return std::numeric_limits<uint64_t>::max ();
+    }
+  return static_cast<uint64_t> (failures);
+}
+
+double
+GeometricErrorModel::GetStateErrorRate (void) const
+{
+  return m_bad ? m_badRate : m_rate;
+}
+
+bool
+GeometricErrorModel::Consume (uint64_t units)
+{
+  if (m_skip >= units)
+    {
+      m_skip -= units;
+      return false;
+    }
+  // further errors in the same packet change nothing, but the distance
+  // to the first error after it has to be drawn from its end
+  do
+    {
+      units -= m_skip + 1;
+      m_skip = DrawGeometric (GetStateErrorRate ());
+    }
+  while (m_skip < units);
+  m_skip -= units;
+  return true;
+}
+
+bool
+GeometricErrorModel::DoCorrupt (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+  if (!m_started)
+    {
+      DoReset ();
+    }
+
+  uint64_t units;
+  switch (m_unit)
+    {
+    case ERROR_UNIT_BIT:
+      units = 8 * static_cast<uint64_t> (p->GetSize ());
+      break;
+    case ERROR_UNIT_BYTE:
+      units = p->GetSize ();
+      break;
+    default:
+      units = 1;
+      break;
+    }
+
+  if (!m_burst)
+    {
+      return Consume (units);
+    }
+
+  bool corrupt = false;
+  while (units > 0)
+    {
+      uint64_t n = std::min (units, m_stateLeft);
+      corrupt = Consume (n) || corrupt;
+      units -= n;
+      m_stateLeft -= n;
+      if (m_stateLeft == 0)
+        {
+          // both distances are memoryless, so they are simply drawn again
+          m_bad = !m_bad;
+          m_stateLeft = DrawGeometric (m_bad ? m_badToGood : m_goodToBad);
+          if (m_stateLeft < std::numeric_limits<uint64_t>::max ())
+            {
+              m_stateLeft++;
+            }
+          m_skip = DrawGeometric (GetStateErrorRate ());
+          NS_LOG_LOGIC ((m_bad ? "Bad" : "Good") << " state for " << m_stateLeft << " units");
+        }
+    }
+  return corrupt;
+}
+
+void
+GeometricErrorModel::DoReset (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_started = true;
+  m_bad = false;
+  m_skip = DrawGeometric (m_rate);
+  m_stateLeft = std::numeric_limits<uint64_t>::max ();
+  if (m_burst)
+    {
+      m_stateLeft = DrawGeometric (m_goodToBad);
+      if (m_stateLeft < std::numeric_limits<uint64_t>::max ())
+        {
+          m_stateLeft++;
+        }
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GEOMETRIC_ERROR_MODEL_H
+#define GEOMETRIC_ERROR_MODEL_H
+
+#include "ns3/error-model.h"
+#include "ns3/random-variable-stream.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Error model drawing the distance to the next error
+ *
+ * Statistically the same as RateErrorModel: every unit (bit, byte or
+ * packet) is corrupted with probability ErrorRate. Instead of drawing a
+ * random number per packet, the number of good units before the next
+ * corrupted one is drawn from a geometric distribution, and packets are
+ * counted against it with no random number at all. At low error rates a
+ * packet costs a subtraction.
+ *
+ * In Gilbert-Elliott mode, the channel alternates between a good state,
+ * with ErrorRate, and a bad state, with BadErrorRate. Each unit leaves the
+ * good state with probability GoodToBad and the bad state with probability
+ * BadToGood, so the time spent in a state is geometric as well and is
+ * drawn once per visit.
+ */
+class GeometricErrorModel : public ErrorModel
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /// Unit of the error rates
+  enum ErrorUnit
+  {
+    ERROR_UNIT_BIT,
+    ERROR_UNIT_BYTE,
+    ERROR_UNIT_PACKET
+  };
+
+  GeometricErrorModel ();
+  virtual ~GeometricErrorModel ();
+
+  /**
+   * \brief Assign a fixed random variable stream number
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned
+   */
+  int64_t AssignStreams (int64_t stream);
+
+private:
+  virtual bool DoCorrupt (Ptr<Packet> p);
+  virtual void DoReset (void);
+
+  /**
+   * \param p success probability of each unit
+   * \return the number of failures before the first success
+   */
+  uint64_t DrawGeometric (double p);
+
+  /**
+   * \brief Count units against the distance to the next error
+   * \param units number of units, all in the current state
+   * \return true if one of them is corrupted
+   */
+  bool Consume (uint64_t units);
+
+  /// Error rate of the current state
+  double GetStateErrorRate (void) const;
+
+  ErrorUnit m_unit;           //!< Unit of the rates
+  double    m_rate;           //!< Error rate, of the good state in burst mode
+  bool      m_burst;          //!< Gilbert-Elliott mode
+  double    m_badRate;        //!< Error rate of the bad state
+  double    m_goodToBad;      //!< Transition probability per unit
+  double    m_badToGood;      //!< Transition probability per unit
+  Ptr<RandomVariableStream> m_ranvar; //!< Uniform variable of the draws
+
+  bool      m_started;        //!< Draws done for the current state
+  bool      m_bad;            //!< In the bad state
+  uint64_t  m_skip;           //!< Good units before the next error
+  uint64_t  m_stateLeft;      //!< Units before leaving the state
+};
+
+} // namespace ns3
+
+#endif /* GEOMETRIC_ERROR_MODEL_H */
@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "instrumented-scheduler.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/event-impl.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <cxxabi.h>
+#include <fstream>
+#include <typeinfo>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("InstrumentedScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (InstrumentedScheduler);
+
+namespace {
+
+double
+WallSeconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Readable name of a type, from its mangled name
+std::string
+Demangle (const char *name)
+{
+  int status;
+  char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+  if (status != 0)
+    {
+      return name;
+    }
+  std::string result (demangled);
+  std::free (demangled);
+  return result;
+}
+
+/// Order of the profile report, most expensive first
+struct MoreWall
+{
+  bool operator() (const std::pair<double, std::pair<uint64_t, const char *> > &a,
+                   const std::pair<double, std::pair<uint64_t, const char *> > &b) const
+  {
+    return a.first > b.first;
+  }
+};
+
+} // anonymous namespace
+
+InstrumentedScheduler *InstrumentedScheduler::s_current = 0;
+
+TypeId
+InstrumentedScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::InstrumentedScheduler")
+    .SetParent<Scheduler> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<InstrumentedScheduler> ()
+    .AddAttribute ("Scheduler",
+                   "TypeId of the scheduler doing the actual work",
+                   StringValue ("ns3::MapScheduler"),
+                   MakeObjectFactoryAccessor (&InstrumentedScheduler::m_innerFactory),
+                   MakeObjectFactoryChecker ())
+    .AddAttribute ("Profile",
+                   "Measure the wall-clock time of the events and sample the queue depth",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&InstrumentedScheduler::m_profile),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DepthInterval",
+                   "Simulated time between two samples of the number of pending events",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&InstrumentedScheduler::m_depthInterval),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+InstrumentedScheduler::InstrumentedScheduler ()
+  : m_inserted (0),
+    m_executed (0),
+    m_cancelled (0),
+    m_removed (0),
+    m_peakSize (0),
+    m_running (0),
+    m_runningSince (0),
+    m_nextSample (0)
+{
+  NS_LOG_FUNCTION (this);
+  s_current = this;
+}
+
+InstrumentedScheduler::~InstrumentedScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+  if (s_current == this)
+    {
+      s_current = 0;
+    }
+}
+
+void
+InstrumentedScheduler::NotifyConstructionCompleted (void)
+{
+  Scheduler::NotifyConstructionCompleted ();
+  m_inner = m_innerFactory.Create<Scheduler> ();
+}
+
+InstrumentedScheduler *
+InstrumentedScheduler::GetCurrent (void)
+{
+  return s_current;
+}
+
+void
+InstrumentedScheduler::Insert (const Event &ev)
+{
+  m_inner->Insert (ev);
+  m_inserted++;
+  uint64_t size = GetSize ();
+  if (size > m_peakSize)
+    {
+      m_peakSize = size;
+    }
+}
+
+bool
+InstrumentedScheduler::IsEmpty (void) const
+{
+  return m_inner->IsEmpty ();
+}
+
+Scheduler::Event
+InstrumentedScheduler::PeekNext (void) const
+{
+  return m_inner->PeekNext ();
+}
+
+Scheduler::Event
+InstrumentedScheduler::RemoveNext (void)
+{
+  Event ev = m_inner->RemoveNext ();
+  if (ev.impl->IsCancelled ())
+    {
+      m_cancelled++;
+    }
+  else
+    {
+      m_executed++;
+    }
+  if (m_profile)
+    {
+      Profile (ev);
+    }
+  return ev;
+}
+
+void
+InstrumentedScheduler::Profile (const Event &ev)
+{
+  // The simulator runs an event right after removing it, and removes the
+  // next one right after, so the time since the last removal is the cost
+  // of the last event (its own work and the events it scheduled).
+  double now = WallSeconds ();
+  if (m_running != 0)
+    {
+      ProfileEntry &entry = m_entries[m_running];
+      entry.calls++;
+      entry.wall += now - m_runningSince;
+    }
+  // a cancelled event is dropped by the simulator without running
+  m_running = ev.impl->IsCancelled () ? 0 : typeid (*ev.impl).name ();
+  m_runningSince = now;
+
+  if (ev.key.m_ts >= m_nextSample)
+    {
+      m_depth.push_back (std::make_pair (ev.key.m_ts, GetSize ()));
+      m_nextSample = ev.key.m_ts + m_depthInterval.GetTimeStep ();
+    }
+}
+
+void
+InstrumentedScheduler::Remove (const Event &ev)
+{
+  m_removed++;
+  m_inner->Remove (ev);
+}
+
+uint64_t
+InstrumentedScheduler::GetInsertCount (void) const
+{
+  return m_inserted;
+}
+
+uint64_t
+InstrumentedScheduler::GetExecuteCount (void) const
+{
+  return m_executed;
+}
+
+uint64_t
+InstrumentedScheduler::GetCancelCount (void) const
+{
+  return m_cancelled;
+}
+
+uint64_t
+InstrumentedScheduler::GetRemoveCount (void) const
+{
+  return m_removed;
+}
+
+uint64_t
+InstrumentedScheduler::GetSize (void) const
+{
+  return m_inserted - m_executed - m_cancelled - m_removed;
+}
+
+uint64_t
+InstrumentedScheduler::GetPeakSize (void) const
+{
+  return m_peakSize;
+}
+
+void
+InstrumentedScheduler::StopProfile (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_running != 0)
+    {
+      ProfileEntry &entry = m_entries[m_running];
+      entry.calls++;
+      entry.wall += WallSeconds () - m_runningSince;
+      m_running = 0;
+    }
+}
+
+void
+InstrumentedScheduler::WriteProfile (const std::string &fileName, const std::string &depthFileName, uint32_t top)
+{
+  NS_LOG_FUNCTION (this << fileName << depthFileName);
+  NS_ABORT_MSG_UNLESS (m_profile, "InstrumentedScheduler::Profile is not enabled");
+  NS_ABORT_MSG_IF (m_running != 0, "InstrumentedScheduler::StopProfile was not called after Simulator::Run");
+
+  std::vector<std::pair<double, std::pair<uint64_t, const char *> > > ranked;
+  double total = 0;
+  for (std::map<const char *, ProfileEntry>::const_iterator i = m_entries.begin (); i != m_entries.end (); ++i)
+    {
+      ranked.push_back (std::make_pair (i->second.wall, std::make_pair (i->second.calls, i->first)));
+      total += i->second.wall;
+    }
+  std::sort (ranked.begin (), ranked.end (), MoreWall ());
+
+  std::ofstream out (fileName.c_str ());
+  out << "target,calls,wall_s,share,ns_per_call" << std::endl;
+  for (size_t i = 0; i < ranked.size (); i++)
+    {
+      double wall = ranked[i].first;
+      uint64_t calls = ranked[i].second.first;
+      std::string target = Demangle (ranked[i].second.second);
+      double share = total > 0 ? wall / total : 0;
+      // the names are full of commas
+      out << "\"" << target << "\"," << calls << "," << wall << "," << share << ","
+          << wall * 1e9 / calls << std::endl;
+      if (i < top)
+        {
+          NS_LOG_UNCOND (100 * share << "% " << calls << " calls " << wall << "s " << target);
+        }
+    }
+
+  std::ofstream depth (depthFileName.c_str ());
+  depth << "time_s,pending" << std::endl;
+  for (size_t i = 0; i < m_depth.size (); i++)
+    {
+      depth << TimeStep (m_depth[i].first).GetSeconds () << "," << m_depth[i].second << std::endl;
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INSTRUMENTED_SCHEDULER_H
+#define INSTRUMENTED_SCHEDULER_H
+
+#include "ns3/scheduler.h"
+#include "ns3/object-factory.h"
+#include "ns3/nstime.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Scheduler counting the events of a run
+ *
+ * Forwards every operation to the scheduler of type Scheduler and counts
+ * the inserted and executed events and the largest number of pending
+ * events. Selected with the global value SchedulerType:
+ *
+ * \code
+ *   GlobalValue::Bind ("SchedulerType", StringValue ("ns3::InstrumentedScheduler"));
+ * \endcode
+ *
+ * The scheduler of the current simulation is returned by GetCurrent.
+ *
+ * With Profile, the wall-clock time between two events leaving the queue
+ * is charged to the first one, grouped by the type of its EventImpl (the
+ * class and signature of the scheduled function), and the number of
+ * pending events is sampled every DepthInterval of simulated time. The
+ * cost is one clock read and one small map lookup per event. StopProfile
+ * has to be called when Simulator::Run returns, so that the last event is
+ * not charged the work done between two runs.
+ *
+ * Cancelled events still leave the queue through RemoveNext, but are not
+ * run: they are counted apart and not profiled.
+ */
+class InstrumentedScheduler : public Scheduler
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  InstrumentedScheduler ();
+  virtual ~InstrumentedScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+  /**
+   * \return the scheduler of the current simulation, 0 if it is not an
+   * InstrumentedScheduler
+   */
+  static InstrumentedScheduler * GetCurrent (void);
+
+  /// \return the number of events inserted
+  uint64_t GetInsertCount (void) const;
+  /// \return the number of events removed to be executed
+  uint64_t GetExecuteCount (void) const;
+  /// \return the number of cancelled events removed by RemoveNext, not executed
+  uint64_t GetCancelCount (void) const;
+  /// \return the number of events removed by Simulator::Remove
+  uint64_t GetRemoveCount (void) const;
+  /// \return the number of pending events
+  uint64_t GetSize (void) const;
+  /// \return the largest number of pending events
+  uint64_t GetPeakSize (void) const;
+
+  /**
+   * \brief Charge the time since the last event to it, and run no event
+   * until the next one leaves the queue
+   *
+   * Called right after every Simulator::Run.
+   */
+  void StopProfile (void);
+
+  /**
+   * \brief Write the profile, event targets ranked by wall-clock time
+   * \param fileName CSV file: target,calls,wall_s,share,ns_per_call
+   * \param depthFileName CSV file of the queue depth: time_s,pending
+   * \param top number of targets also printed to the log
+   */
+  void WriteProfile (const std::string &fileName, const std::string &depthFileName, uint32_t top);
+
+protected:
+  virtual void NotifyConstructionCompleted (void);
+
+private:
+  /// Time spent in the events of one target
+  struct ProfileEntry
+  {
+    uint64_t calls; //!< Events executed
+    double   wall;  //!< Wall-clock seconds
+  };
+
+  /**
+   * \brief Charge the time since the last event to it, and sample the depth
+   * \param ev the event leaving the queue
+   */
+  void Profile (const Event &ev);
+
+  ObjectFactory  m_innerFactory; //!< Factory of the real scheduler
+  Ptr<Scheduler> m_inner;        //!< Real scheduler
+  uint64_t       m_inserted;     //!< Events inserted
+  uint64_t       m_executed;     //!< Events removed by RemoveNext to be run
+  uint64_t       m_cancelled;    //!< Cancelled events removed by RemoveNext
+  uint64_t       m_removed;      //!< Events removed by Remove
+  uint64_t       m_peakSize;     //!< Largest number of pending events
+
+  bool           m_profile;       //!< Profile the events
+  Time           m_depthInterval; //!< Simulated time between depth samples
+  std::map<const char *, ProfileEntry> m_entries; //!< Profile, by type name
+  const char    *m_running;       //!< Type name of the running event
+  double         m_runningSince;  //!< Wall-clock start of the running event
+  uint64_t       m_nextSample;    //!< Timestamp of the next depth sample
+  std::vector<std::pair<uint64_t, uint64_t> > m_depth; //!< Timestamp, pending events
+
+  static InstrumentedScheduler *s_current; //!< Scheduler of the simulation
+};
+
+} // namespace ns3
+
+#endif /* INSTRUMENTED_SCHEDULER_H */
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tcp-flow-stats.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpFlowStats");
+
+TcpFlowStats::TcpFlowStats ()
+  : m_start (-1),
+    m_last (0),
+    m_cwnd (0),
+    m_phase (SLOW_START),
+    m_weight (0),
+    m_mean (0),
+    m_m2 (0),
+    m_ackedBytes (0),
+    m_retransmittedBytes (0)
+{
+  for (int i = 0; i < PHASES; i++)
+    {
+      m_phaseTime[i] = 0;
+    }
+}
+
+void
+TcpFlowStats::Accumulate (double &weight, double &mean, double &m2, double w, double x)
+{
+  double total = weight + w;
+  double delta = x - mean;
+  double r = delta * w / total;
+  mean += r;
+  m2 += weight * delta * r;
+  weight = total;
+}
+
+void
+TcpFlowStats::Record (int64_t time, uint32_t cwnd, Phase phase)
+{
+  if (m_start < 0)
+    {
+      m_start = time;
+    }
+  else if (time > m_last)
+    {
+      Accumulate (m_weight, m_mean, m_m2, (time - m_last) * 1e-9, m_cwnd);
+      m_phaseTime[m_phase] += time - m_last;
+    }
+  m_last = std::max (m_last, time);
+  m_cwnd = cwnd;
+  m_phase = phase;
+}
+
+bool
+TcpFlowStats::IsStarted (void) const
+{
+  return m_start >= 0;
+}
+
+int64_t
+TcpFlowStats::GetStartTime (void) const
+{
+  return m_start;
+}
+
+uint64_t
+TcpFlowStats::GetAckedBytes (void) const
+{
+  return m_ackedBytes;
+}
+
+uint64_t
+TcpFlowStats::GetRetransmittedBytes (void) const
+{
+  return m_retransmittedBytes;
+}
+
+double
+TcpFlowStats::GetCwndMean (int64_t now) const
+{
+  double weight = m_weight;
+  double mean = m_mean;
+  double m2 = m_m2;
+  if (IsStarted () && now > m_last)
+    {
+      Accumulate (weight, mean, m2, (now - m_last) * 1e-9, m_cwnd);
+    }
+  return weight > 0 ? mean : m_cwnd;
+}
+
+double
+TcpFlowStats::GetCwndVariance (int64_t now) const
+{
+  double weight = m_weight;
+  double mean = m_mean;
+  double m2 = m_m2;
+  if (IsStarted () && now > m_last)
+    {
+      Accumulate (weight, mean, m2, (now - m_last) * 1e-9, m_cwnd);
+    }
+  return weight > 0 ? m2 / weight : 0;
+}
+
+int64_t
+TcpFlowStats::GetPhaseTime (Phase phase, int64_t now) const
+{
+  int64_t time = m_phaseTime[phase];
+  if (IsStarted () && phase == m_phase && now > m_last)
+    {
+      time += now - m_last;
+    }
+  return time;
+}
+
+double
+TcpFlowStats::GetGoodput (int64_t now) const
+{
+  if (!IsStarted () || now <= m_start)
+    {
+      return 0;
+    }
+  return m_ackedBytes * 8.0 / ((now - m_start) * 1e-9);
+}
+
+void
+TcpFlowStats::WriteLine (const std::string &fileName, const std::string &header, const std::string &line)
+{
+  // files started by this process, the next lines are appended
+  static std::set<std::string> started;
+  bool first = started.insert (fileName).second;
+  std::ofstream file (fileName.c_str (), first ? std::ios::out | std::ios::trunc : std::ios::out | std::ios::app);
+  NS_ABORT_MSG_UNLESS (file, "Cannot open statistics file " << fileName);
+  if (first)
+    {
+      file << header << std::endl;
+    }
+  file << line << std::endl;
+}
+
+} // namespace ns3
@@ -0,0 +1,140 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TCP_FLOW_STATS_H
+#define TCP_FLOW_STATS_H
+
+#include <stdint.h>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Running statistics of the congestion state of a socket, in
+ * constant memory
+ *
+ * cwnd is a step function of time: every Record holds a value until the
+ * next one, and its time-weighted mean and variance are updated with the
+ * weighted form of Welford's algorithm (West 1979), so nothing is stored
+ * per ACK. The time between two records is also added to the phase the
+ * socket was in.
+ *
+ * The getters take the current time, to count the value held since the
+ * last record without changing the statistics. Everything starts at the
+ * first record.
+ */
+class TcpFlowStats
+{
+public:
+  /// Congestion control phase of the socket
+  enum Phase
+  {
+    SLOW_START = 0,           //!< cwnd below ssthresh
+    CONGESTION_AVOIDANCE = 1, //!< cwnd at or above ssthresh
+    FAST_RECOVERY = 2,        //!< After a triple dupack, until the full ACK
+    PHASES = 3                //!< Number of phases
+  };
+
+  TcpFlowStats ();
+
+  /**
+   * \brief Hold a new congestion state from now on
+   * \param time simulation time, in nanoseconds
+   * \param cwnd congestion window, in bytes
+   * \param phase the Phase the socket is in
+   */
+  void Record (int64_t time, uint32_t cwnd, Phase phase);
+
+  /// \param bytes bytes newly acknowledged by the peer
+  void AddAcked (uint32_t bytes)
+  {
+    m_ackedBytes += bytes;
+  }
+  /// \param bytes bytes sent again
+  void AddRetransmitted (uint32_t bytes)
+  {
+    m_retransmittedBytes += bytes;
+  }
+
+  /// \return true once Record has been called
+  bool IsStarted (void) const;
+
+  /// \return time of the first record, in nanoseconds
+  int64_t GetStartTime (void) const;
+  /// \return bytes acknowledged by the peer
+  uint64_t GetAckedBytes (void) const;
+  /// \return bytes sent again
+  uint64_t GetRetransmittedBytes (void) const;
+
+  /**
+   * \param now current simulation time, in nanoseconds
+   * \return the time-weighted mean of cwnd, in bytes
+   */
+  double GetCwndMean (int64_t now) const;
+  /**
+   * \param now current simulation time, in nanoseconds
+   * \return the time-weighted variance of cwnd, in bytes squared
+   */
+  double GetCwndVariance (int64_t now) const;
+  /**
+   * \param phase a Phase
+   * \param now current simulation time, in nanoseconds
+   * \return the time spent in the phase, in nanoseconds
+   */
+  int64_t GetPhaseTime (Phase phase, int64_t now) const;
+  /**
+   * \param now current simulation time, in nanoseconds
+   * \return the acknowledged bits per second since the first record
+   */
+  double GetGoodput (int64_t now) const;
+
+  /**
+   * \brief Append a line to a file, truncating it and writing \p header
+   * first the first time this process writes to it
+   * \param fileName name of the file
+   * \param header column names, without end of line
+   * \param line the line, without end of line
+   */
+  static void WriteLine (const std::string &fileName, const std::string &header, const std::string &line);
+
+private:
+  /**
+   * \brief Add a value held for some time to a weighted mean and variance
+   * \param weight total time so far, in seconds, updated
+   * \param mean weighted mean so far, updated
+   * \param m2 weighted sum of the squared deviations so far, updated
+   * \param w time the value was held, in seconds
+   * \param x the value
+   */
+  static void Accumulate (double &weight, double &mean, double &m2, double w, double x);
+
+  int64_t  m_start;              //!< Time of the first record, -1 before it
+  int64_t  m_last;               //!< Time of the last record
+  uint32_t m_cwnd;               //!< cwnd held since the last record
+  Phase    m_phase;              //!< Phase held since the last record
+  double   m_weight;             //!< Seconds accounted in the mean
+  double   m_mean;               //!< Time-weighted mean of cwnd
+  double   m_m2;                 //!< Time-weighted sum of the squared deviations of cwnd
+  int64_t  m_phaseTime[PHASES];  //!< Nanoseconds spent in each phase
+  uint64_t m_ackedBytes;         //!< Bytes acknowledged
+  uint64_t m_retransmittedBytes; //!< Bytes sent again
+};
+
+} // namespace ns3
+
+#endif /* TCP_FLOW_STATS_H */
@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "tcp-sack-tag.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (TcpSackTag);
+
+TypeId
+TcpSackTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpSackTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpSackTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpSackTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+TcpSackTag::TcpSackTag ()
+  : m_nBlocks (0),
+    m_duplicate (false)
+{
+}
+
+bool
+TcpSackTag::AddBlock (SequenceNumber32 start, SequenceNumber32 end)
+{
+  if (m_nBlocks == MAX_BLOCKS)
+    {
+      return false;
+    }
+  m_start[m_nBlocks] = start.GetValue ();
+  m_end[m_nBlocks] = end.GetValue ();
+  m_nBlocks++;
+  return true;
+}
+
+uint32_t
+TcpSackTag::GetNBlocks (void) const
+{
+  return m_nBlocks;
+}
+
+SequenceNumber32
+TcpSackTag::GetBlockStart (uint32_t i) const
+{
+  NS_ASSERT (i < m_nBlocks);
+  return SequenceNumber32 (m_start[i]);
+}
+
+SequenceNumber32
+TcpSackTag::GetBlockEnd (uint32_t i) const
+{
+  NS_ASSERT (i < m_nBlocks);
+  return SequenceNumber32 (m_end[i]);
+}
+
+void
+TcpSackTag::SetDuplicate (bool duplicate)
+{
+  m_duplicate = duplicate;
+}
+
+bool
+TcpSackTag::IsDuplicate (void) const
+{
+  return m_duplicate;
+}
+
+uint32_t
+TcpSackTag::GetSerializedSize (void) const
+{
+  return 1 + 8 * m_nBlocks;
+}
+
+void
+TcpSackTag::Serialize (TagBuffer i) const
+{
+  // number of blocks in the low bits, D-SACK flag in the high bit
+  i.WriteU8 (m_nBlocks | (m_duplicate ? 0x80 : 0));
+  for (uint8_t b = 0; b < m_nBlocks; b++)
+    {
+      i.WriteU32 (m_start[b]);
+      i.WriteU32 (m_end[b]);
+    }
+}
+
+void
+TcpSackTag::Deserialize (TagBuffer i)
+{
+  uint8_t flags = i.ReadU8 ();
+  m_nBlocks = flags & 0x7f;
+  m_duplicate = (flags & 0x80) != 0;
+  NS_ASSERT (m_nBlocks <= MAX_BLOCKS);
+  for (uint8_t b = 0; b < m_nBlocks; b++)
+    {
+      m_start[b] = i.ReadU32 ();
+      m_end[b] = i.ReadU32 ();
+    }
+}
+
+void
+TcpSackTag::Print (std::ostream &os) const
+{
+  os << "SACK";
+  for (uint8_t b = 0; b < m_nBlocks; b++)
+    {
+      os << " " << m_start[b] << "-" << m_end[b];
+    }
+  if (m_duplicate)
+    {
+      os << " D-SACK";
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,90 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef TCP_SACK_TAG_H
+#define TCP_SACK_TAG_H
+
+#include "ns3/tag.h"
+#include "ns3/sequence-number.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Selective acknowledgment blocks carried by an ACK
+ *
+ * Stands in for the TCP SACK option (RFC 2018), which the TcpHeader of
+ * this ns-3 version cannot carry: the receiver attaches the tag to its
+ * ACKs and the sender reads it with the ACK. Like a D-SACK (RFC 2883), the
+ * tag also tells the sender that the segment being acknowledged had
+ * already been received.
+ *
+ * A packet tag holds at most PACKET_TAG_MAX_SIZE bytes, so only two
+ * blocks fit, against three in a real option next to the timestamps. The
+ * most recently received block comes first, so the sender still learns
+ * every block over successive ACKs.
+ */
+class TcpSackTag : public Tag
+{
+public:
+  /// Maximum number of blocks in a tag
+  static const uint32_t MAX_BLOCKS = 2;
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  TcpSackTag ();
+
+  /**
+   * \brief Add a block of received bytes
+   * \param start first sequence number of the block
+   * \param end sequence number following the block
+   * \return false if the tag is full
+   */
+  bool AddBlock (SequenceNumber32 start, SequenceNumber32 end);
+  /// \return the number of blocks
+  uint32_t GetNBlocks (void) const;
+  /// \return the first sequence number of block \p i
+  SequenceNumber32 GetBlockStart (uint32_t i) const;
+  /// \return the sequence number following block \p i
+  SequenceNumber32 GetBlockEnd (uint32_t i) const;
+
+  /// \param duplicate whether the acknowledged segment had already been received
+  void SetDuplicate (bool duplicate);
+  /// \return true if the acknowledged segment had already been received
+  bool IsDuplicate (void) const;
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint8_t  m_nBlocks;                //!< Number of blocks
+  bool     m_duplicate;              //!< D-SACK flag
+  uint32_t m_start[MAX_BLOCKS];      //!< Start of the blocks
+  uint32_t m_end[MAX_BLOCKS];        //!< End of the blocks
+};
+
+} // namespace ns3
+
+#endif /* TCP_SACK_TAG_H */
@@ -27,10 +27,28 @@
 #include "ns3/simulator.h"
 #include "ns3/abort.h"
 #include "ns3/node.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/nstime.h"
+#include "ipv4-end-point.h"
+#include "ipv4-l3-protocol.h"
+#include "tcp-l4-protocol.h"
+#include "tcp-sack-tag.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
 
-#define TCP_SCALABLE_AI_CNT     50U
-#define TCP_SCALABLE_MD_SCALE   3
+
+// Text logging of the ACK path. Define TCP_SCALABLE_FAST to compile it out.
+#ifdef TCP_SCALABLE_FAST
+#define TCP_SCALABLE_LOG(msg) do { } while (false)
+#else
+#define TCP_SCALABLE_LOG(msg) NS_LOG_UNCOND (msg)
+#endif
 
 
 namespace ns3 {
@@ -38,175 +56,871 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("TcpScalable");
 
 NS_OBJECT_ENSURE_REGISTERED (TcpScalable);
+NS_OBJECT_ENSURE_REGISTERED (TcpScalableAggressive);
+NS_OBJECT_ENSURE_REGISTERED (TcpRenoFast);
+NS_OBJECT_ENSURE_REGISTERED (TcpHighSpeed);
+
+uint32_t
+TcpHighSpeedPolicy::AckInterval (uint32_t cwndSegments, uint32_t aiCnt)
+{
+  if (cwndSegments <= LOW_WINDOW)
+    {
+      return cwndSegments;
+    }
+  // a(w) = w^2 p(w) 2 b(w) / (2 - b(w)) segments per RTT, p(w) = 0.078 / w^1.2
+  double w = cwndSegments;
+  double b = DecreaseFraction (cwndSegments);
+  double a = w * w * 0.078 / std::pow (w, 1.2) * 2 * b / (2 - b);
+  return std::max (static_cast<uint32_t> (w / a), 1U);
+}
+
+uint32_t
+TcpHighSpeedPolicy::Decrease (uint32_t cwnd, uint32_t segmentSize, uint32_t mdScale)
+{
+  uint32_t w = cwnd / segmentSize;
+  if (w <= LOW_WINDOW)
+    {
+      return cwnd - (cwnd >> 1);
+    }
+  return static_cast<uint32_t> (cwnd * (1 - DecreaseFraction (w)));
+}
+
+double
+TcpHighSpeedPolicy::DecreaseFraction (uint32_t cwndSegments)
+{
+  // b(w) goes from 0.5 at LOW_WINDOW down to 0.1 at HIGH_WINDOW, linearly in log (w)
+  double w = std::min (cwndSegments, static_cast<uint32_t> (HIGH_WINDOW));
+  return (0.1 - 0.5) * (std::log (w) - std::log (static_cast<double> (LOW_WINDOW)))
+         / (std::log (static_cast<double> (HIGH_WINDOW)) - std::log (static_cast<double> (LOW_WINDOW)))
+         + 0.5;
+}
 
+template <class Policy>
 TypeId
-TcpScalable::GetTypeId (void)
+TcpAimdSocket<Policy>::GetTypeId (void)
 {
-  static TypeId tid = TypeId ("ns3::TcpScalable")
+  static TypeId tid = TypeId (Policy::GetName ())
     .SetParent<TcpSocketBase> ()
     .SetGroupName ("Internet")
-    .AddConstructor<TcpScalable> ()
+    .AddConstructor<TcpAimdSocket<Policy> > ()
+    .AddAttribute ("AiCount",
+                   "Congestion avoidance adds one segment every min (cwnd, AiCount) acked segments",
+                   UintegerValue (Policy::AI_CNT),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::m_aiCnt),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MdScale",
+                   "A loss reduces cwnd by cwnd / 2^MdScale",
+                   UintegerValue (Policy::MD_SCALE),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::m_mdScale),
+                   MakeUintegerChecker<uint32_t> (1, 31))
+    .AddAttribute ("TracePrefix",
+                   "Prefix of the per-flow cwnd/ssthresh trace files, empty to disable",
+                   StringValue (""),
+                   MakeStringAccessor (&TcpAimdSocket<Policy>::m_tracePrefix),
+                   MakeStringChecker ())
+    .AddAttribute ("TraceBufferSize",
+                   "Number of trace records buffered in memory before being written",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::m_traceBufferSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TraceInterval",
+                   "Keep only the min and max cwnd and ssthresh of every interval in the "
+                   "flow trace, zero to keep every change",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&TcpAimdSocket<Policy>::m_traceInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("Sack",
+                   "Report the received blocks in the ACKs and retransmit only the holes they leave",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&TcpAimdSocket<Policy>::m_sack),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Pacing",
+                   "Spread the segments of each window over the smoothed RTT",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpAimdSocket<Policy>::m_pacing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PacingGain",
+                   "Pacing rate in congestion avoidance, in cwnd per smoothed RTT",
+                   DoubleValue (1.2),
+                   MakeDoubleAccessor (&TcpAimdSocket<Policy>::m_pacingGain),
+                   MakeDoubleChecker<double> (0.1))
+    .AddAttribute ("PacingSsGain",
+                   "Pacing rate in slow start, in cwnd per smoothed RTT",
+                   DoubleValue (2.0),
+                   MakeDoubleAccessor (&TcpAimdSocket<Policy>::m_pacingSsGain),
+                   MakeDoubleChecker<double> (0.1))
+    .AddAttribute ("PacingBurst",
+                   "Segments sent back to back by one pacing timer event",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::m_pacingBurst),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("RetransmittedSegments",
+                   "Number of segments sent more than once",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::GetRetransmittedSegments),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RedundantSegments",
+                   "Number of segments the receiver reported as already received",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::GetRedundantSegments),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StatsFile",
+                   "File to which one line of flow statistics is appended when the socket "
+                   "is closed, empty to disable",
+                   StringValue (""),
+                   MakeStringAccessor (&TcpAimdSocket<Policy>::m_statsFile),
+                   MakeStringChecker ())
+    .AddAttribute ("CwndMean",
+                   "Time-weighted mean of cwnd since the first ACK, in bytes",
+                   TypeId::ATTR_GET,
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&TcpAimdSocket<Policy>::GetCwndMean),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CwndVariance",
+                   "Time-weighted variance of cwnd since the first ACK, in bytes squared",
+                   TypeId::ATTR_GET,
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&TcpAimdSocket<Policy>::GetCwndVariance),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("SlowStartTime",
+                   "Time spent in slow start",
+                   TypeId::ATTR_GET,
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&TcpAimdSocket<Policy>::GetSlowStartTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("CongestionAvoidanceTime",
+                   "Time spent in congestion avoidance",
+                   TypeId::ATTR_GET,
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&TcpAimdSocket<Policy>::GetCongestionAvoidanceTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("FastRecoveryTime",
+                   "Time spent in fast recovery",
+                   TypeId::ATTR_GET,
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&TcpAimdSocket<Policy>::GetFastRecoveryTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("FastRecoveries",
+                   "Number of fast recoveries entered on a triple duplicate ACK",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::GetFastRecoveries),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Timeouts",
+                   "Number of retransmission timeouts",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::GetTimeouts),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("AckedBytes",
+                   "Number of bytes acknowledged by the peer",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::GetAckedBytes),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("RetransmittedBytes",
+                   "Number of bytes sent more than once",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpAimdSocket<Policy>::GetRetransmittedBytes),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("Goodput",
+                   "Acknowledged bits per second since the first ACK",
+                   TypeId::ATTR_GET,
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&TcpAimdSocket<Policy>::GetGoodput),
+                   MakeDoubleChecker<double> ())
+    .AddTraceSource ("RetransmittedSegments",
+                     "Number of segments sent more than once",
+                     MakeTraceSourceAccessor (&TcpAimdSocket<Policy>::m_retransmitted),
+                     "ns3::TracedValue::Uint32Callback")
+    .AddTraceSource ("RedundantSegments",
+                     "Number of segments the receiver reported as already received",
+                     MakeTraceSourceAccessor (&TcpAimdSocket<Policy>::m_redundant),
+                     "ns3::TracedValue::Uint32Callback")
+    .AddTraceSource ("FastRecoveries",
+                     "Number of fast recoveries entered on a triple duplicate ACK",
+                     MakeTraceSourceAccessor (&TcpAimdSocket<Policy>::m_recoveries),
+                     "ns3::TracedValue::Uint32Callback")
+    .AddTraceSource ("Timeouts",
+                     "Number of retransmission timeouts",
+                     MakeTraceSourceAccessor (&TcpAimdSocket<Policy>::m_timeouts),
+                     "ns3::TracedValue::Uint32Callback")
   ;
   return tid;
 }
 
-TcpScalable::TcpScalable (void) : m_successfulAckCount (0)
+template <class Policy>
+TcpAimdSocket<Policy>::TcpAimdSocket (void)
+  : m_successfulAckCount (0),
+    m_aiCnt (Policy::AI_CNT),
+    m_mdScale (Policy::MD_SCALE),
+    m_inFastRecovery (false),
+    m_traceBufferSize (4096),
+    m_sack (true),
+    m_rxDuplicate (false),
+    m_ackTagPending (false),
+    m_pacing (false),
+    m_pacingGain (1.2),
+    m_pacingSsGain (2.0),
+    m_pacingBurst (2),
+    m_pacingStarted (false),
+    m_pacingTokens (0),
+    m_retransmitted (0),
+    m_redundant (0),
+    m_statsWritten (false),
+    m_recoveries (0),
+    m_timeouts (0)
 {
   NS_LOG_FUNCTION (this);
 }
 
-TcpScalable::TcpScalable (const TcpScalable& sock)
+template <class Policy>
+TcpAimdSocket<Policy>::TcpAimdSocket (const TcpAimdSocket<Policy>& sock)
   : TcpSocketBase (sock),
-    m_successfulAckCount (0)
+    m_successfulAckCount (0),
+    m_aiCnt (sock.m_aiCnt),
+    m_mdScale (sock.m_mdScale),
+    m_inFastRecovery (false),
+    m_tracePrefix (sock.m_tracePrefix),
+    m_traceBufferSize (sock.m_traceBufferSize),
+    m_traceInterval (sock.m_traceInterval),
+    m_sack (sock.m_sack),
+    m_rxDuplicate (false),
+    m_ackTagPending (false),
+    m_pacing (sock.m_pacing),
+    m_pacingGain (sock.m_pacingGain),
+    m_pacingSsGain (sock.m_pacingSsGain),
+    m_pacingBurst (sock.m_pacingBurst),
+    m_pacingStarted (false),
+    m_pacingTokens (0),
+    m_retransmitted (0),
+    m_redundant (0),
+    m_statsFile (sock.m_statsFile),
+    m_statsWritten (false),
+    m_recoveries (0),
+    m_timeouts (0)
 {
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC ("Invoked the copy constructor");
 }
 
-TcpScalable::~TcpScalable (void)
+template <class Policy>
+TcpAimdSocket<Policy>::~TcpAimdSocket (void)
 {
   // m_ssThresh = 0x7fffffff; // from tcp.h
 }
 
-void TcpScalable::SetInitialSSThresh (uint32_t threshold) {
+template <class Policy>
+void TcpAimdSocket<Policy>::SetInitialSSThresh (uint32_t threshold) {
   // m_initialSsThresh = 0x7fffffff;
   TcpSocketBase::SetInitialSSThresh(threshold);
 }
 
+template <class Policy>
+void
+TcpAimdSocket<Policy>::OpenFlowTrace (void)
+{
+  FlowTraceFileHeader flow;
+  std::memset (&flow, 0, sizeof (flow));
+  std::memcpy (flow.magic, FLOW_TRACE_MAGIC, sizeof (flow.magic));
+  flow.nodeId = m_node->GetId ();
+  flow.protocol = TcpL4Protocol::PROT_NUMBER;
+  if (m_endPoint != 0)
+    {
+      flow.localAddress = m_endPoint->GetLocalAddress ().Get ();
+      flow.localPort = m_endPoint->GetLocalPort ();
+      flow.peerAddress = m_endPoint->GetPeerAddress ().Get ();
+      flow.peerPort = m_endPoint->GetPeerPort ();
+    }
+
+  std::ostringstream fileName;
+  fileName << m_tracePrefix << "node" << flow.nodeId
+           << "-" << Ipv4Address (flow.localAddress) << "." << flow.localPort
+           << "-" << Ipv4Address (flow.peerAddress) << "." << flow.peerPort << ".ftr";
+  m_trace.Open (fileName.str (), flow, m_traceBufferSize, m_traceInterval.GetNanoSeconds ());
+}
+
+template <class Policy>
+std::string
+TcpAimdSocket<Policy>::GetFlowName (void) const
+{
+  std::ostringstream name;
+  name << m_node->GetId () << ",";
+  if (m_endPoint != 0)
+    {
+      name << m_endPoint->GetLocalAddress () << "," << m_endPoint->GetLocalPort () << ","
+           << m_endPoint->GetPeerAddress () << "," << m_endPoint->GetPeerPort ();
+    }
+  else
+    {
+      name << ",,,";
+    }
+  return name.str ();
+}
+
+template <class Policy>
+int
+TcpAimdSocket<Policy>::Close (void)
+{
+  WriteStats ();
+  return TcpSocketBase::Close ();
+}
+
+template <class Policy>
+void
+TcpAimdSocket<Policy>::DoDispose (void)
+{
+  // while the simulator still runs its destroy events, unlike the destructor
+  WriteStats ();
+  m_pacingEvent.Cancel ();
+  if (m_ackTagIpv4)
+    {
+      m_ackTagIpv4->TraceDisconnectWithoutContext ("SendOutgoing", MakeCallback (&TcpAimdSocket<Policy>::TagAck, this));
+      m_ackTagIpv4 = 0;
+    }
+  TcpSocketBase::DoDispose ();
+}
+
+template <class Policy>
+void
+TcpAimdSocket<Policy>::WriteStats (void)
+{
+  // sockets which never got an ACK, e.g. the ones accepted by a sink, have
+  // nothing to report
+  if (m_statsFile.empty () || m_statsWritten || !m_stats.IsStarted ())
+    {
+      return;
+    }
+  m_statsWritten = true;
+
+  int64_t now = Simulator::Now ().GetNanoSeconds ();
+  std::ostringstream line;
+  line << Simulator::Now ().GetSeconds () << "," << m_statsFlow << ","
+       << m_stats.GetAckedBytes () << "," << m_stats.GetGoodput (now) / 1000 << ","
+       << m_stats.GetCwndMean (now) << "," << std::sqrt (m_stats.GetCwndVariance (now)) << ","
+       << m_stats.GetPhaseTime (TcpFlowStats::SLOW_START, now) * 1e-9 << ","
+       << m_stats.GetPhaseTime (TcpFlowStats::CONGESTION_AVOIDANCE, now) * 1e-9 << ","
+       << m_stats.GetPhaseTime (TcpFlowStats::FAST_RECOVERY, now) * 1e-9 << ","
+       << m_recoveries << "," << m_timeouts << "," << m_stats.GetRetransmittedBytes ();
+  NS_LOG_INFO ("Flow statistics " << line.str ());
+  TcpFlowStats::WriteLine (m_statsFile,
+                           "time,node,localAddress,localPort,peerAddress,peerPort,ackedBytes,goodputKbps,"
+                           "cwndMean,cwndStdDev,slowStart_s,congAvoid_s,fastRecovery_s,"
+                           "fastRecoveries,timeouts,retransmittedBytes",
+                           line.str ());
+}
+
+template <class Policy>
 Ptr<TcpSocketBase>
-TcpScalable::Fork (void)
+TcpAimdSocket<Policy>::Fork (void)
 {
-  return CopyObject<TcpScalable> (this);
+  return CopyObject<TcpAimdSocket<Policy> > (this);
 }
 
 /* New ACK (up to seqnum seq) received. Increase cwnd and call TcpSocketBase::NewAck() */
+template <class Policy>
 void
-TcpScalable::NewAck (SequenceNumber32 const& seq)
-{
-  // m_successfulAckCount += 1;
-  // // NS_LOG_FUNCTION (this << seq);
-  // NS_LOG_UNCOND ("TcpScalable received ACK for seq " << seq <<
-  //               " cwnd " << m_cWnd <<
-  //               " ssthresh " << m_ssThresh);
-  // if (m_cWnd < m_ssThresh)
-  //   { // Slow start mode
-  //     m_cWnd = std::min(m_cWnd + m_segmentSize, m_ssThresh);
-  //     NS_LOG_UNCOND ("In SlowStart, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
-  //   }
-  // else
-  //   { // Congestion avoidance mode
-  //     // To increase cwnd for one segSize per 100 ACK
-  //     if (m_successfulAckCount >= 100) {
-  //       m_cWnd += m_segmentSize;
-  //       m_successfulAckCount = 0;
-  //       NS_LOG_UNCOND ("In CongAvoid, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
-  //     }
-  //   }
-  // TcpSocketBase::NewAck (seq);           // Complete newAck processing
-  m_successfulAckCount += 1;
-  NS_LOG_UNCOND ("Received ACK for seq " << seq <<
-                " cwnd " << m_cWnd <<
-                " ssthresh " << m_ssThresh);
-  if (m_cWnd < m_ssThresh)
+TcpAimdSocket<Policy>::NewAck (SequenceNumber32 const& seq)
+{
+  TCP_SCALABLE_LOG ("Received ACK for seq " << seq <<
+                    " cwnd " << m_cWnd <<
+                    " ssthresh " << m_ssThresh);
+
+  uint32_t ackedBytes = seq - m_txBuffer->HeadSequence ();
+  m_stats.AddAcked (ackedBytes);
+  if (m_pacing && !m_pacingStarted)
+    { // the smoothed RTT has a sample now, start with a full bucket
+      m_pacingStarted = true;
+      m_pacingTokens = m_pacingBurst * m_segmentSize;
+      m_pacingRefill = Simulator::Now ();
+    }
+  if (m_inFastRecovery && seq < m_recover)
+    { // Partial ACK, the next segment is lost too: deflate cwnd by the amount
+      // acked, add back one segment and retransmit (RFC6582, sec.3.2 step 5)
+      m_cWnd = (ackedBytes < m_cWnd.Get () ? m_cWnd.Get () - ackedBytes : 0) + m_segmentSize;
+      TCP_SCALABLE_LOG ("Partial ACK in fast recovery, cwnd " << m_cWnd);
+      m_txBuffer->DiscardUpTo (seq);  // Retransmit the segment after seq, not seq itself
+      if (m_sacked.empty () || m_highRxt <= seq)
+        {
+          DoRetransmit ();
+        }
+      else
+        { // The new hole at seq is already retransmitted, send the next one
+          RetransmitHole ();
+        }
+      TcpSocketBase::NewAck (seq);
+      TraceCongestionState (TcpTraceRecord::NEW_ACK);
+      return;
+    }
+  else if (m_inFastRecovery)
+    { // Full ACK, leave fast recovery with the reduced window (RFC6582, sec.3.2 step 6)
+      m_cWnd = std::min (m_ssThresh.Get (), BytesInFlight () + m_segmentSize);
+      m_inFastRecovery = false;
+      m_successfulAckCount = 0;
+      TCP_SCALABLE_LOG ("Full ACK, leaving fast recovery with cwnd " << m_cWnd);
+    }
+  else if (m_cWnd < m_ssThresh)
     { // Slow start mode, add one segSize to cWnd. Default m_ssThresh is 65535. (RFC2001, sec.1)
       m_cWnd += m_segmentSize;
-      NS_LOG_UNCOND ("In SlowStart, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
+      TCP_SCALABLE_LOG ("In SlowStart, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
     }
   else
-    { // Congestion avoidance mode, increase by (segSize*segSize)/cwnd. (RFC2581, sec.3.1)
-      // To increase cwnd for one segSize per RTT, it should be (ackBytes*segSize)/cwnd
-      // double adder = static_cast<double> (m_segmentSize * m_segmentSize) / m_cWnd.Get ();
-      // adder = std::max (1.0, adder);
-      // m_cWnd += static_cast<uint32_t> (adder);
-      if (m_successfulAckCount >= 100) {
-        m_cWnd += m_segmentSize;
-        m_successfulAckCount = 0;
-        NS_LOG_UNCOND ("In CongAvoid, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
-      }
-      NS_LOG_UNCOND ("In CongAvoid, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
+    { // Congestion avoidance mode, add one segment every Policy::AckInterval
+      // acked segments. For Scalable TCP it is min (cwnd, AiCount), i.e. cwnd
+      // grows by 1/AiCount of itself per RTT once it is larger than AiCount
+      // segments (Kelly 2003)
+      uint32_t ackInterval = Policy::AckInterval (m_cWnd.Get () / m_segmentSize, m_aiCnt);
+      m_successfulAckCount += std::max (ackedBytes / m_segmentSize, 1U);
+      if (m_successfulAckCount >= ackInterval)
+        {
+          m_cWnd += m_segmentSize;
+          m_successfulAckCount = 0;
+        }
+      TCP_SCALABLE_LOG ("In CongAvoid, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
     }
   TcpSocketBase::NewAck (seq);           // Complete newAck processing
 
-  NS_LOG_UNCOND ("CSV," << this << "," << Simulator::Now ().GetSeconds () << "," << m_cWnd << "," << m_ssThresh);
+  TraceCongestionState (TcpTraceRecord::NEW_ACK);
+  TCP_SCALABLE_LOG ("CSV," << this << "," << Simulator::Now ().GetSeconds () << "," << m_cWnd << "," << m_ssThresh);
 }
 
-/* Cut down ssthresh upon triple dupack */
+/* Multiplicative decrease and fast recovery upon triple dupack */
+template <class Policy>
 void
-TcpScalable::DupAck (const TcpHeader& t, uint32_t count)
-{
-  m_successfulAckCount = 0; // reset
-  // m_ssThresh = std::max (static_cast<unsigned> (m_cWnd - (m_cWnd / 8)), m_segmentSize * 2);  // ssthresh*7/8
-  // // m_cWnd = std::max (static_cast<unsigned> (m_cWnd - (m_cWnd / 8)), m_segmentSize * 2);  // ssthresh*7/8
-  // // m_cWnd = m_segmentSize; // Run slow start again
-  // // m_nextTxSequence = m_txBuffer->HeadSequence (); // Restart from highest Ack
-  // DoRetransmit ();
-  // NS_LOG_UNCOND ("DupAck " << count << ". m_ssThresh updated to " << m_ssThresh);
-  // // if (count == m_retxThresh)
-  // //   { // triple duplicate ack triggers fast retransmit (RFC2001, sec.3)
-  // //     NS_LOG_UNCOND ("Triple Dup Ack: old ssthresh " << m_ssThresh << " cwnd " << m_cWnd);
-  // //     // fast retransmit in Scalable means triggering RTO earlier. Tx is restarted
-  // //     // from the highest ack and run slow start again.
-  // //     // (Fall & Floyd 1996, sec.1)
-  // //     m_ssThresh = std::max (static_cast<unsigned> (m_cWnd / 2), m_segmentSize * 2);  // Half ssthresh
-  // //     m_cWnd = m_segmentSize; // Run slow start again
-  // //     m_nextTxSequence = m_txBuffer->HeadSequence (); // Restart from highest Ack
-  // //     NS_LOG_INFO ("Triple Dup Ack: new ssthresh " << m_ssThresh << " cwnd " << m_cWnd);
-  // //     NS_LOG_LOGIC ("Triple Dup Ack: retransmit missing segment at " << Simulator::Now ().GetSeconds ());
-  // //     DoRetransmit ();
-  // //   }
-
-  NS_LOG_UNCOND ("DupAck " << count);
-  if (count == 3)
-    { // triple duplicate ack triggers fast retransmit (RFC2001, sec.3)
-      NS_LOG_UNCOND ("Triple Dup Ack: old ssthresh " << m_ssThresh << " cwnd " << m_cWnd);
-      // fast retransmit in Tahoe means triggering RTO earlier. Tx is restarted
-      // from the highest ack and run slow start again.
-      // (Fall & Floyd 1996, sec.1)
-      m_ssThresh = std::max (static_cast<unsigned> (m_cWnd - m_cWnd / 8), m_segmentSize * 2);  // Half ssthresh
-      m_cWnd = m_segmentSize; // Run slow start again
-      m_nextTxSequence = m_txBuffer->HeadSequence (); // Restart from highest Ack
-      NS_LOG_UNCOND ("Triple Dup Ack: new ssthresh " << m_ssThresh << " cwnd " << m_cWnd);
-      NS_LOG_UNCOND ("Triple Dup Ack: retransmit missing segment at " << Simulator::Now ().GetSeconds ());
+TcpAimdSocket<Policy>::DupAck (const TcpHeader& t, uint32_t count)
+{
+  TCP_SCALABLE_LOG ("DupAck " << count);
+  if (count == 3 && !m_inFastRecovery)
+    { // triple duplicate ack triggers fast retransmit (RFC2001, sec.3). The
+      // policy decrease (1/2^MdScale of the window for Scalable TCP) is
+      // applied and sending goes on during the recovery instead of
+      // restarting slow start.
+      TCP_SCALABLE_LOG ("Triple Dup Ack: old ssthresh " << m_ssThresh << " cwnd " << m_cWnd);
+      m_ssThresh = DecreasedWindow ();
+      m_cWnd = m_ssThresh.Get () + 3 * m_segmentSize;
+      m_recover = m_highTxMark;
+      m_inFastRecovery = true;
+      m_successfulAckCount = 0;
+      m_highRxt = m_txBuffer->HeadSequence ();
+      m_recoveries++;
+      TCP_SCALABLE_LOG ("Triple Dup Ack: new ssthresh " << m_ssThresh << " cwnd " << m_cWnd);
+      TCP_SCALABLE_LOG ("Triple Dup Ack: retransmit missing segment at " << Simulator::Now ().GetSeconds ());
       DoRetransmit ();
+      TraceCongestionState (TcpTraceRecord::FAST_RETRANSMIT);
+    }
+  else if (m_inFastRecovery)
+    { // Increase cwnd for every additional dupack (RFC6582, sec.3.2 step 4),
+      // and use it for the next hole if SACK shows one, new data otherwise
+      m_cWnd += m_segmentSize;
+      if (!RetransmitHole () && !m_sendPendingDataEvent.IsRunning ())
+        {
+          SendPendingData (m_connected);
+        }
+      TraceCongestionState (TcpTraceRecord::DUP_ACK);
+    }
+  else
+    {
+      TraceCongestionState (TcpTraceRecord::DUP_ACK);
     }
-  NS_LOG_UNCOND ("CSV," << this << "," << Simulator::Now ().GetSeconds () << "," << m_cWnd << "," << m_ssThresh);
+  TCP_SCALABLE_LOG ("CSV," << this << "," << Simulator::Now ().GetSeconds () << "," << m_cWnd << "," << m_ssThresh);
 }
 
 /* Retransmit timeout */
-void TcpScalable::Retransmit (void)
-{
-  m_successfulAckCount = 0; // reset
-  // // NS_LOG_FUNCTION (this);
-  // // NS_LOG_LOGIC (this << " ReTxTimeout Expired at time " << Simulator::Now ().GetSeconds ());
-  // // // m_inFastRec = false;
-
-  // // If erroneous timeout in closed/timed-wait state, just return
-  // if (m_state == CLOSED || m_state == TIME_WAIT) return;
-  // // If all data are received (non-closing socket and nothing to send), just return
-  // if (m_state <= ESTABLISHED && m_txBuffer->HeadSequence () >= m_highTxMark) return;
-
-  // // According to RFC2581 sec.3.1, upon RTO, ssthresh is set to half of flight
-  // // size and cwnd is set to 1*MSS, then the lost packet is retransmitted and
-  // // TCP back to slow start
-  // m_ssThresh = std::max (2 * m_segmentSize, BytesInFlight () - BytesInFlight () / 8);
-  // m_cWnd = m_segmentSize;
-  // // m_nextTxSequence = m_txBuffer->HeadSequence (); // Restart from highest Ack
-  // NS_LOG_INFO ("RTO. Reset cwnd to " << m_cWnd <<
-  //              ", ssthresh to " << m_ssThresh << ", restart from seqnum " << m_nextTxSequence);
-  // DoRetransmit ();                          // Retransmit the packet
-
-  NS_LOG_UNCOND ("ReTxTimeout Expired at time " << Simulator::Now ().GetSeconds ());
+template <class Policy>
+void TcpAimdSocket<Policy>::Retransmit (void)
+{
+  TCP_SCALABLE_LOG ("ReTxTimeout Expired at time " << Simulator::Now ().GetSeconds ());
+  m_inFastRecovery = false;
+  m_successfulAckCount = 0;
+
   // If erroneous timeout in closed/timed-wait state, just return
   if (m_state == CLOSED || m_state == TIME_WAIT) return;
   // If all data are received (non-closing socket and nothing to send), just return
   if (m_state <= ESTABLISHED && m_txBuffer->HeadSequence () >= m_highTxMark) return;
 
-  m_ssThresh = std::max (static_cast<unsigned> (m_cWnd - m_cWnd / 8), m_segmentSize * 2);  // Half ssthresh
+  // The whole window is considered lost: same decrease as a triple dupack
+  // for ssthresh, then slow start from one segment (RFC5681, sec.3.1)
+  m_ssThresh = DecreasedWindow ();
   m_cWnd = m_segmentSize;                   // Set cwnd to 1 segSize (RFC2001, sec.2)
   m_nextTxSequence = m_txBuffer->HeadSequence (); // Restart from highest Ack
+  m_highRxt = m_txBuffer->HeadSequence ();
+  // The receiver may have discarded what it SACKed, so the blocks are
+  // forgotten and only the ones reported again are skipped (RFC2018, sec.8)
+  m_sacked.clear ();
+  m_timeouts++;
   DoRetransmit ();                          // Retransmit the packet
 
-  NS_LOG_UNCOND ("CSV," << this << "," << Simulator::Now ().GetSeconds () << "," << m_cWnd << "," << m_ssThresh);
+  TraceCongestionState (TcpTraceRecord::RTO);
+  TCP_SCALABLE_LOG ("CSV," << this << "," << Simulator::Now ().GetSeconds () << "," << m_cWnd << "," << m_ssThresh);
+}
+
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::DecreasedWindow (void) const
+{
+  return std::max (Policy::Decrease (m_cWnd.Get (), m_segmentSize, m_mdScale), 2 * m_segmentSize);
+}
+
+template <class Policy>
+typename TcpAimdSocket<Policy>::SackBlocks::iterator
+TcpAimdSocket<Policy>::AddBlock (SackBlocks &blocks, SequenceNumber32 start, SequenceNumber32 end)
+{
+  typename SackBlocks::iterator i = blocks.upper_bound (start);
+  if (i != blocks.begin ())
+    {
+      typename SackBlocks::iterator previous = i;
+      --previous;
+      if (previous->second >= start)
+        { // extends the previous block
+          start = previous->first;
+          end = std::max (end, previous->second);
+          blocks.erase (previous);
+        }
+    }
+  while (i != blocks.end () && i->first <= end)
+    { // swallows the next blocks
+      end = std::max (end, i->second);
+      blocks.erase (i++);
+    }
+  return blocks.insert (std::make_pair (start, end)).first;
+}
+
+template <class Policy>
+void
+TcpAimdSocket<Policy>::DiscardBlocks (SackBlocks &blocks, SequenceNumber32 seq)
+{
+  while (!blocks.empty () && blocks.begin ()->first < seq)
+    {
+      SequenceNumber32 end = blocks.begin ()->second;
+      blocks.erase (blocks.begin ());
+      if (end > seq)
+        {
+          blocks.insert (std::make_pair (seq, end));
+          break;
+        }
+    }
+}
+
+/* Read the SACK blocks and duplicate reports of the peer, then process the ACK */
+template <class Policy>
+void
+TcpAimdSocket<Policy>::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
+{
+  TcpSackTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      if (tag.IsDuplicate ())
+        {
+          m_redundant++;
+        }
+      for (uint32_t i = 0; m_sack && i < tag.GetNBlocks (); i++)
+        {
+          AddBlock (m_sacked, tag.GetBlockStart (i), tag.GetBlockEnd (i));
+        }
+    }
+  DiscardBlocks (m_sacked, tcpHeader.GetAckNumber ());
+  TcpSocketBase::ReceivedAck (packet, tcpHeader);
+}
+
+/* Track the blocks received beyond the cumulative ACK, and tag the ACK of
+   a segment which is out of order or already received */
+template <class Policy>
+void
+TcpAimdSocket<Policy>::ReceivedData (Ptr<Packet> packet, const TcpHeader& tcpHeader)
+{
+  SequenceNumber32 start = tcpHeader.GetSequenceNumber ();
+  SequenceNumber32 end = start + packet->GetSize ();
+  if (packet->GetSize () == 0)
+    {
+      TcpSocketBase::ReceivedData (packet, tcpHeader);
+      return;
+    }
+
+  // in order data without holes, the common case, is acknowledged as usual
+  SequenceNumber32 expected = m_rxBuffer->NextRxSequence ();
+  m_rxDuplicate = end <= expected;
+  if (!m_rxDuplicate && !m_rxBlocks.empty ())
+    {
+      typename SackBlocks::iterator i = m_rxBlocks.upper_bound (start);
+      if (i != m_rxBlocks.begin ())
+        {
+          --i;
+          m_rxDuplicate = end <= i->second;
+        }
+    }
+  if (start > expected)
+    {
+      AddBlock (m_rxBlocks, start, end);
+    }
+  m_rxLastSeq = start;
+  m_ackTagPending = m_rxDuplicate || !m_rxBlocks.empty ();
+  if (m_ackTagPending && !m_ackTagIpv4)
+    {
+      m_ackTagIpv4 = m_node->GetObject<Ipv4L3Protocol> ();
+      m_ackTagIpv4->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&TcpAimdSocket<Policy>::TagAck, this));
+    }
+
+  TcpSocketBase::ReceivedData (packet, tcpHeader);
+
+  m_ackTagPending = false;
+  DiscardBlocks (m_rxBlocks, m_rxBuffer->NextRxSequence ());
 }
 
+template <class Policy>
+void
+TcpAimdSocket<Policy>::TagAck (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  if (!m_ackTagPending)
+    {
+      return;
+    }
+  m_ackTagPending = false;
+
+  TcpSackTag tag;
+  tag.SetDuplicate (m_rxDuplicate);
+  if (m_sack)
+    {
+      // the block of the last segment first (RFC2018, sec.4), then the lowest ones
+      DiscardBlocks (m_rxBlocks, m_rxBuffer->NextRxSequence ());
+      typename SackBlocks::iterator last = m_rxBlocks.upper_bound (m_rxLastSeq);
+      if (last != m_rxBlocks.begin () && (--last)->second > m_rxLastSeq)
+        {
+          tag.AddBlock (last->first, last->second);
+        }
+      else
+        {
+          last = m_rxBlocks.end ();
+        }
+      for (typename SackBlocks::iterator i = m_rxBlocks.begin (); i != m_rxBlocks.end (); ++i)
+        {
+          if (i != last && !tag.AddBlock (i->first, i->second))
+            {
+              break;
+            }
+        }
+    }
+  packet->AddPacketTag (tag);
+}
+
+template <class Policy>
+bool
+TcpAimdSocket<Policy>::RetransmitHole (void)
+{
+  if (m_sacked.empty ())
+    {
+      return false;
+    }
+  // first byte neither SACKed nor retransmitted yet, below the highest SACKed byte
+  SequenceNumber32 hole = std::max (m_txBuffer->HeadSequence (), m_highRxt);
+  for (typename SackBlocks::const_iterator i = m_sacked.begin (); i != m_sacked.end (); ++i)
+    {
+      if (hole < i->first)
+        {
+          SendDataPacket (hole, std::min (static_cast<uint32_t> (i->first - hole), m_segmentSize), true);
+          return true;
+        }
+      hole = std::max (hole, i->second);
+    }
+  return false;
+}
+
+/* Send or retransmit a segment, without sending again what the peer holds */
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck)
+{
+  if (seq >= m_highTxMark)
+    {
+      uint32_t size = TcpSocketBase::SendDataPacket (seq, maxSize, withAck);
+      if (m_pacingStarted)
+        {
+          m_pacingTokens -= size;
+        }
+      return size;
+    }
+
+  if (!m_sacked.empty ())
+    {
+      typename SackBlocks::const_iterator next = m_sacked.upper_bound (seq);
+      if (next != m_sacked.begin ())
+        {
+          typename SackBlocks::const_iterator block = next;
+          --block;
+          if (block->second > seq)
+            { // held by the peer: report it as sent, so that go-back-N after a
+              // timeout moves on to the next hole once it is SACKed again
+              return std::min (static_cast<uint32_t> (block->second - seq), maxSize);
+            }
+        }
+      if (next != m_sacked.end () && next->first < seq + maxSize)
+        {
+          maxSize = next->first - seq;
+        }
+    }
+  // the segment may extend past the highest byte sent, which is new data
+  uint32_t sentBefore = m_highTxMark - seq;
+  uint32_t size = TcpSocketBase::SendDataPacket (seq, maxSize, withAck);
+  if (m_pacingStarted)
+    {
+      m_pacingTokens -= size;
+    }
+  m_retransmitted++;
+  m_stats.AddRetransmitted (std::min (size, sentBefore));
+  m_highRxt = std::max (m_highRxt, seq + size);
+  return size;
+}
+
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::AvailableWindow (void)
+{
+  uint32_t window = TcpSocketBase::AvailableWindow ();
+  if (!m_pacingStarted || window == 0)
+    {
+      return window;
+    }
+  RefillPacingTokens ();
+  if (m_pacingTokens >= window)
+    {
+      return window;
+    }
+  if (m_pacingTokens < m_segmentSize)
+    {
+      SchedulePacing (window);
+      return 0;
+    }
+  return static_cast<uint32_t> (m_pacingTokens);
+}
+
+template <class Policy>
+void
+TcpAimdSocket<Policy>::RefillPacingTokens (void)
+{
+  Time now = Simulator::Now ();
+  m_pacingTokens = std::min (m_pacingTokens + PacingRate () * (now - m_pacingRefill).GetSeconds (),
+                             static_cast<double> (m_pacingBurst * m_segmentSize));
+  m_pacingRefill = now;
+}
+
+template <class Policy>
+void
+TcpAimdSocket<Policy>::SchedulePacing (uint32_t window)
+{
+  if (m_pacingEvent.IsRunning ())
+    {
+      return;
+    }
+  // wait for a whole burst rather than a segment, to batch the sends
+  double target = std::min (m_pacingBurst * m_segmentSize, std::max (window, m_segmentSize));
+  m_pacingEvent = Simulator::Schedule (Seconds ((target - m_pacingTokens) / PacingRate ()),
+                                       &TcpAimdSocket<Policy>::PacingTimeout, this);
+}
+
+template <class Policy>
+double
+TcpAimdSocket<Policy>::PacingRate (void) const
+{
+  double gain = m_cWnd < m_ssThresh ? m_pacingSsGain : m_pacingGain;
+  return gain * m_cWnd.Get () / std::max (m_rtt->GetEstimate ().GetSeconds (), 1e-6);
+}
+
+template <class Policy>
+void
+TcpAimdSocket<Policy>::PacingTimeout (void)
+{
+  SendPendingData (m_connected);
+}
+
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::GetRetransmittedSegments (void) const
+{
+  return m_retransmitted;
+}
+
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::GetRedundantSegments (void) const
+{
+  return m_redundant;
+}
+
+template <class Policy>
+double
+TcpAimdSocket<Policy>::GetCwndMean (void) const
+{
+  return m_stats.GetCwndMean (Simulator::Now ().GetNanoSeconds ());
+}
+
+template <class Policy>
+double
+TcpAimdSocket<Policy>::GetCwndVariance (void) const
+{
+  return m_stats.GetCwndVariance (Simulator::Now ().GetNanoSeconds ());
+}
+
+template <class Policy>
+Time
+TcpAimdSocket<Policy>::GetSlowStartTime (void) const
+{
+  return NanoSeconds (m_stats.GetPhaseTime (TcpFlowStats::SLOW_START, Simulator::Now ().GetNanoSeconds ()));
+}
+
+template <class Policy>
+Time
+TcpAimdSocket<Policy>::GetCongestionAvoidanceTime (void) const
+{
+  return NanoSeconds (m_stats.GetPhaseTime (TcpFlowStats::CONGESTION_AVOIDANCE, Simulator::Now ().GetNanoSeconds ()));
+}
+
+template <class Policy>
+Time
+TcpAimdSocket<Policy>::GetFastRecoveryTime (void) const
+{
+  return NanoSeconds (m_stats.GetPhaseTime (TcpFlowStats::FAST_RECOVERY, Simulator::Now ().GetNanoSeconds ()));
+}
+
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::GetFastRecoveries (void) const
+{
+  return m_recoveries;
+}
+
+template <class Policy>
+uint32_t
+TcpAimdSocket<Policy>::GetTimeouts (void) const
+{
+  return m_timeouts;
+}
+
+template <class Policy>
+uint64_t
+TcpAimdSocket<Policy>::GetAckedBytes (void) const
+{
+  return m_stats.GetAckedBytes ();
+}
+
+template <class Policy>
+uint64_t
+TcpAimdSocket<Policy>::GetRetransmittedBytes (void) const
+{
+  return m_stats.GetRetransmittedBytes ();
+}
+
+template <class Policy>
+double
+TcpAimdSocket<Policy>::GetGoodput (void) const
+{
+  return m_stats.GetGoodput (Simulator::Now ().GetNanoSeconds ());
+}
+
+template class TcpAimdSocket<TcpScalablePolicy>;
+template class TcpAimdSocket<TcpScalableAggressivePolicy>;
+template class TcpAimdSocket<TcpRenoPolicy>;
+template class TcpAimdSocket<TcpHighSpeedPolicy>;
+
 } // namespace ns3
@@ -22,18 +22,173 @@
 #define TCP_SCALABLE_H
 
 #include "tcp-socket-base.h"
+#include "tcp-trace-buffer.h"
+#include "tcp-flow-stats.h"
+#include "ns3/simulator.h"
+#include "ns3/traced-value.h"
+#include "ns3/event-id.h"
+
+#include <algorithm>
+#include <map>
 
 namespace ns3 {
 
+class Ipv4Header;
+class Ipv4L3Protocol;
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Scalable TCP (Kelly 2003), the policy of ns3::TcpScalable
+ *
+ * A congestion control policy is a type with:
+ *  - GetName (), the TypeId name of the socket;
+ *  - AI_CNT and MD_SCALE, the defaults of the AiCount and MdScale attributes;
+ *  - AckInterval (cwndSegments, aiCnt), the number of acked segments per
+ *    one-segment increase of cwnd in congestion avoidance;
+ *  - Decrease (cwnd, segmentSize, mdScale), cwnd after a loss.
+ *
+ * The policy is a template parameter of TcpAimdSocket, so its functions are
+ * inlined in the ACK path without any virtual call or runtime switch.
+ */
+struct TcpScalablePolicy
+{
+  enum { AI_CNT = 50, MD_SCALE = 3 };
+
+  static const char * GetName (void)
+  {
+    return "ns3::TcpScalable";
+  }
+  static uint32_t AckInterval (uint32_t cwndSegments, uint32_t aiCnt)
+  {
+    return std::min (cwndSegments, aiCnt);
+  }
+  static uint32_t Decrease (uint32_t cwnd, uint32_t segmentSize, uint32_t mdScale)
+  {
+    return cwnd - (cwnd >> mdScale);
+  }
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Scalable TCP growing twice as fast and backing off by 1/16
+ */
+struct TcpScalableAggressivePolicy : public TcpScalablePolicy
+{
+  enum { AI_CNT = 25, MD_SCALE = 4 };
+
+  static const char * GetName (void)
+  {
+    return "ns3::TcpScalableAggressive";
+  }
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Reno: one segment per RTT, halve the window on loss
+ *
+ * AiCount is not used.
+ */
+struct TcpRenoPolicy
+{
+  enum { AI_CNT = 1, MD_SCALE = 1 };
+
+  static const char * GetName (void)
+  {
+    return "ns3::TcpRenoFast";
+  }
+  static uint32_t AckInterval (uint32_t cwndSegments, uint32_t aiCnt)
+  {
+    return cwndSegments;
+  }
+  static uint32_t Decrease (uint32_t cwnd, uint32_t segmentSize, uint32_t mdScale)
+  {
+    return cwnd - (cwnd >> mdScale);
+  }
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief HighSpeed TCP (RFC 3649)
+ *
+ * Behaves as Reno up to LOW_WINDOW segments, then uses the a(w) and b(w)
+ * response functions of the RFC. AiCount and MdScale are not used.
+ */
+struct TcpHighSpeedPolicy
+{
+  enum { AI_CNT = 1, MD_SCALE = 1, LOW_WINDOW = 38, HIGH_WINDOW = 83000 };
+
+  static const char * GetName (void)
+  {
+    return "ns3::TcpHighSpeed";
+  }
+  static uint32_t AckInterval (uint32_t cwndSegments, uint32_t aiCnt);
+  static uint32_t Decrease (uint32_t cwnd, uint32_t segmentSize, uint32_t mdScale);
+  /**
+   * \return b(w), the fraction of the window removed on loss
+   */
+  static double DecreaseFraction (uint32_t cwndSegments);
+};
+
 /**
  * \ingroup socket
  * \ingroup tcp
  *
  * \brief An implementation of a stream socket using TCP.
  *
- * This class contains the Scalable congestion control algorithm implementation of TCP.
+ * This class contains the AIMD congestion control of TCP, with the increase
+ * and decrease rules given by the Policy (see TcpScalablePolicy).
+ *
+ * In congestion avoidance, cwnd grows by one segment every
+ * Policy::AckInterval acked segments. A triple dupack applies
+ * Policy::Decrease to the window and enters NewReno-style fast recovery;
+ * a retransmission timeout applies the same decrease to ssthresh and
+ * restarts from one segment.
+ *
+ * Every instantiation registers its own TypeId: ns3::TcpScalable,
+ * ns3::TcpScalableAggressive, ns3::TcpRenoFast and ns3::TcpHighSpeed.
+ *
+ * When the TracePrefix attribute is set, every change of the congestion
+ * state is stored as a binary TcpTraceRecord in a preallocated per-socket
+ * buffer, which is written in columnar blocks of TraceBufferSize records to
+ * a file of its own per flow (see flow-trace-format.h). The file is named
+ * after the flow: <prefix>node<id>-<local addr>.<port>-<peer addr>.<port>.ftr
+ * With TraceInterval, only the min and max of each interval are written,
+ * for plots of long runs (see FlowTraceDownsampler).
+ *
+ * With Sack, the receiver reports the blocks it holds beyond the cumulative
+ * ACK (see TcpSackTag) and the sender keeps them in a scoreboard: during
+ * fast recovery every further duplicate ACK retransmits the next hole
+ * instead of sending new data, a partial ACK does not resend a hole
+ * already retransmitted. A timeout clears the scoreboard, since the
+ * receiver may have discarded what it SACKed (RFC 2018, sec. 8): go-back-N
+ * only skips the blocks reported again after it. Receivers always report
+ * duplicate segments, so RetransmittedSegments and RedundantSegments can
+ * be compared with Sack on and off.
+ *
+ * With Pacing, the sending rate is limited to PacingGain (PacingSsGain in
+ * slow start) times cwnd per smoothed RTT by a token bucket of PacingBurst
+ * segments, checked in AvailableWindow. When the bucket runs dry, one
+ * timer event per socket sends the next PacingBurst segments, so there is
+ * one event per burst rather than per segment.
+ *
+ * Every socket keeps running statistics of its flow in constant memory
+ * (see TcpFlowStats): the time-weighted mean and variance of cwnd, the
+ * time spent in slow start, congestion avoidance and fast recovery, the
+ * number of fast recoveries and timeouts, the bytes retransmitted and the
+ * goodput. They are read through attributes, and with StatsFile set, one
+ * CSV line per flow is appended to that file when the application closes
+ * the socket, or when the socket is destroyed if it never did.
+ *
+ * The per-ACK text log (including the "CSV,..." lines) is compiled out
+ * when TCP_SCALABLE_FAST is defined, e.g. with
+ * CXXFLAGS="-DTCP_SCALABLE_FAST" ./waf configure
  */
-class TcpScalable : public TcpSocketBase
+template <class Policy>
+class TcpAimdSocket : public TcpSocketBase
 {
 public:
   /**
@@ -44,24 +199,188 @@ public:
   /**
    * Create an unbound tcp socket.
    */
-  TcpScalable (void);
+  TcpAimdSocket (void);
   /**
    * \brief Copy constructor
    * \param sock the object to copy
    */
-  TcpScalable (const TcpScalable& sock);
-  virtual ~TcpScalable (void);
+  TcpAimdSocket (const TcpAimdSocket<Policy>& sock);
+  virtual ~TcpAimdSocket (void);
+
+  virtual int Close (void); // Write the flow statistics
 
 protected:
-  virtual Ptr<TcpSocketBase> Fork (void); // Call CopyObject<TcpScalable> to clone me
+  virtual void DoDispose (void); // Write the flow statistics of a socket never closed
+  virtual Ptr<TcpSocketBase> Fork (void); // Call CopyObject<TcpAimdSocket> to clone me
   virtual void NewAck (SequenceNumber32 const& seq); // Inc cwnd and call NewAck() of parent
-  virtual void DupAck (const TcpHeader& t, uint32_t count);  // Treat 3 dupack as timeout
+  virtual void DupAck (const TcpHeader& t, uint32_t count);  // Fast retransmit and recovery
   virtual void Retransmit (void); // Retransmit time out
   virtual void     SetInitialSSThresh (uint32_t threshold);
+  virtual void ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader); // Read the SACK blocks
+  virtual void ReceivedData (Ptr<Packet> packet, const TcpHeader& tcpHeader); // Track the received blocks
+  virtual uint32_t SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck); // Skip SACKed data
+  virtual uint32_t AvailableWindow (void); // Limited by the pacing tokens
+
+  /**
+   * \return the pacing rate, in bytes per second
+   */
+  double PacingRate (void) const;
+  /**
+   * \brief Add the tokens earned since the last refill
+   */
+  void RefillPacingTokens (void);
+  /**
+   * \brief Send again once the bucket holds a burst, or what the window allows
+   * \param window the window available without pacing
+   */
+  void SchedulePacing (uint32_t window);
+  /**
+   * \brief Pacing timer expired, send what the tokens allow
+   */
+  void PacingTimeout (void);
+
+  /// \return the number of segments sent more than once
+  uint32_t GetRetransmittedSegments (void) const;
+  /// \return the number of segments the peer reported as received twice
+  uint32_t GetRedundantSegments (void) const;
+
+  /// \return the time-weighted mean of cwnd, in bytes
+  double GetCwndMean (void) const;
+  /// \return the time-weighted variance of cwnd, in bytes squared
+  double GetCwndVariance (void) const;
+  /// \return the time spent with cwnd below ssthresh, outside of fast recovery
+  Time GetSlowStartTime (void) const;
+  /// \return the time spent with cwnd at or above ssthresh, outside of fast recovery
+  Time GetCongestionAvoidanceTime (void) const;
+  /// \return the time spent in fast recovery
+  Time GetFastRecoveryTime (void) const;
+  /// \return the number of fast recoveries entered on a triple dupack
+  uint32_t GetFastRecoveries (void) const;
+  /// \return the number of retransmission timeouts
+  uint32_t GetTimeouts (void) const;
+  /// \return the bytes acknowledged by the peer
+  uint64_t GetAckedBytes (void) const;
+  /// \return the bytes sent more than once
+  uint64_t GetRetransmittedBytes (void) const;
+  /// \return the acknowledged bits per second since the first ACK
+  double GetGoodput (void) const;
+
+  /**
+   * \brief Append the statistics of the flow to StatsFile, once
+   */
+  void WriteStats (void);
+
+  /**
+   * \brief Retransmit the first hole of the scoreboard not retransmitted yet
+   * \return false if there is no such hole
+   */
+  bool RetransmitHole (void);
+
+  /**
+   * \brief Attach the received blocks to the ACK being sent
+   *
+   * Connected to the SendOutgoing trace of the node, and only acts while
+   * ReceivedData runs, i.e. on the ACK of the received segment.
+   */
+  void TagAck (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+
+  /// Blocks of sequence numbers, start to end
+  typedef std::map<SequenceNumber32, SequenceNumber32> SackBlocks;
+
+  /**
+   * \brief Add a block to a set of blocks, merging the ones it touches
+   * \return the merged block
+   */
+  static SackBlocks::iterator AddBlock (SackBlocks &blocks, SequenceNumber32 start, SequenceNumber32 end);
+  /**
+   * \brief Remove the parts of the blocks below a sequence number
+   */
+  static void DiscardBlocks (SackBlocks &blocks, SequenceNumber32 seq);
+
+  /**
+   * \return cwnd reduced by Policy::Decrease, at least two segments
+   */
+  uint32_t DecreasedWindow (void) const;
+
+  /**
+   * \brief Account the current cwnd and phase in the flow statistics, and
+   * store cwnd and ssthresh in the flow trace
+   * \param event the TcpTraceRecord::Event which changed them
+   */
+  void TraceCongestionState (uint8_t event)
+  {
+    if (!m_stats.IsStarted () && !m_statsFile.empty ())
+      {
+        m_statsFlow = GetFlowName ();
+      }
+    m_stats.Record (Simulator::Now ().GetNanoSeconds (), m_cWnd,
+                    m_inFastRecovery ? TcpFlowStats::FAST_RECOVERY
+                    : m_cWnd < m_ssThresh ? TcpFlowStats::SLOW_START
+                    : TcpFlowStats::CONGESTION_AVOIDANCE);
+    if (m_tracePrefix.empty ())
+      {
+        return;
+      }
+    if (!m_trace.IsOpen ())
+      {
+        OpenFlowTrace ();
+      }
+    m_trace.Record (Simulator::Now ().GetNanoSeconds (), m_cWnd, m_ssThresh, event);
+  }
+
+  /**
+   * \brief Open the trace file of the flow, named after its 5-tuple
+   */
+  void OpenFlowTrace (void);
+
+  /**
+   * \return the node, local and peer address and port of the flow,
+   *         comma separated
+   */
+  std::string GetFlowName (void) const;
+
 protected:
-  uint32_t               m_successfulAckCount;
+  uint32_t               m_successfulAckCount; //!< Segments acked since the last cwnd increase
+  uint32_t               m_aiCnt;            //!< Max segments acked per cwnd increase
+  uint32_t               m_mdScale;          //!< Log2 of the multiplicative decrease divisor
+  bool                   m_inFastRecovery;   //!< In fast recovery after a triple dupack
+  SequenceNumber32       m_recover;          //!< Highest sequence sent when fast recovery started
+  std::string            m_tracePrefix;      //!< Flow trace file prefix, empty to disable
+  uint32_t               m_traceBufferSize;  //!< Records buffered between two writes
+  Time                   m_traceInterval;    //!< Downsampling interval of the trace, zero for none
+  TcpTraceBuffer         m_trace;            //!< Flow trace buffer
+
+  bool                   m_sack;             //!< Use and send SACK blocks
+  SackBlocks             m_sacked;           //!< Sender scoreboard, blocks held by the peer
+  SequenceNumber32       m_highRxt;          //!< End of the highest retransmission of the recovery
+  SackBlocks             m_rxBlocks;         //!< Receiver, blocks held beyond the cumulative ACK
+  SequenceNumber32       m_rxLastSeq;        //!< Receiver, last segment received
+  bool                   m_rxDuplicate;      //!< Receiver, the last segment was held already
+  bool                   m_ackTagPending;    //!< Receiver, the next outgoing ACK gets a TcpSackTag
+  Ptr<Ipv4L3Protocol>    m_ackTagIpv4;       //!< Receiver, IP layer traced by TagAck
+  bool                   m_pacing;           //!< Pace the segments over the RTT
+  double                 m_pacingGain;       //!< Rate over cwnd / srtt in congestion avoidance
+  double                 m_pacingSsGain;     //!< Rate over cwnd / srtt in slow start
+  uint32_t               m_pacingBurst;      //!< Bucket depth and timer batch, in segments
+  bool                   m_pacingStarted;    //!< An RTT sample exists, pacing applies
+  double                 m_pacingTokens;     //!< Bytes that can be sent now, negative when in debt
+  Time                   m_pacingRefill;     //!< Time of the last refill
+  EventId                m_pacingEvent;      //!< Pacing timer
+  TracedValue<uint32_t>  m_retransmitted;    //!< Segments sent more than once
+  TracedValue<uint32_t>  m_redundant;        //!< Segments the peer received twice
+  TcpFlowStats           m_stats;            //!< Running statistics of the flow
+  std::string            m_statsFile;        //!< File of the statistics lines, empty to disable
+  std::string            m_statsFlow;        //!< GetFlowName at the first ACK, the end point may be gone at the end
+  bool                   m_statsWritten;     //!< The statistics line has been written
+  TracedValue<uint32_t>  m_recoveries;       //!< Fast recoveries entered
+  TracedValue<uint32_t>  m_timeouts;         //!< Retransmission timeouts
 };
 
+typedef TcpAimdSocket<TcpScalablePolicy> TcpScalable;
+typedef TcpAimdSocket<TcpScalableAggressivePolicy> TcpScalableAggressive;
+typedef TcpAimdSocket<TcpRenoPolicy> TcpRenoFast;
+typedef TcpAimdSocket<TcpHighSpeedPolicy> TcpHighSpeed;
+
 } // namespace ns3
 
 #endif /* TCP_SCALABLE_H */
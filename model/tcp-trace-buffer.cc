@@ -0,0 +1,189 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tcp-trace-buffer.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+
+#include <cstring>
+#include <set>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpTraceBuffer");
+
+namespace {
+
+/// Every open buffer, for FlushAll and ReopenAll
+std::set<TcpTraceBuffer *> &
+OpenBuffers (void)
+{
+  static std::set<TcpTraceBuffer *> buffers;
+  return buffers;
+}
+
+/// Directory of the traces of a forked process, set by ReopenAll
+std::string &
+BranchDir (void)
+{
+  static std::string dir;
+  return dir;
+}
+
+/// \return the name of the file \p fileName in the directory of the process
+std::string
+BranchFileName (const std::string &fileName)
+{
+  if (BranchDir ().empty ())
+    {
+      return fileName;
+    }
+  std::string::size_type slash = fileName.rfind ('/');
+  return BranchDir () + "/" + (slash == std::string::npos ? fileName : fileName.substr (slash + 1));
+}
+
+} // anonymous namespace
+
+TcpTraceBuffer::TcpTraceBuffer ()
+  : m_file (0),
+    m_size (0),
+    m_downsampled (false),
+    m_downsampler (0, Appender (this))
+{
+}
+
+TcpTraceBuffer::~TcpTraceBuffer ()
+{
+  m_downsampler.Finish ();
+  Flush ();
+  if (m_file)
+    {
+      std::fclose (m_file);
+      OpenBuffers ().erase (this);
+    }
+}
+
+void
+TcpTraceBuffer::Open (const std::string &fileName, const FlowTraceFileHeader &flow, uint32_t capacity,
+                      int64_t bucket)
+{
+  NS_LOG_FUNCTION (this << fileName << capacity << bucket);
+  NS_ABORT_MSG_IF (capacity == 0, "TCP trace buffer needs room for at least one record");
+  NS_ABORT_MSG_IF (m_file != 0, "TCP trace buffer already open");
+  m_flow = flow;
+  // flows starting after a fork trace into the files of their process
+  OpenFile (BranchFileName (fileName));
+  OpenBuffers ().insert (this);
+
+  TcpTraceRecord empty;
+  std::memset (&empty, 0, sizeof (empty));
+  m_records.assign (capacity, empty);
+  m_size = 0;
+  // worst case of the varints, reserved once
+  m_block.reserve (capacity * (10 + 10 + 10 + 1));
+  m_downsampled = bucket > 0;
+  m_downsampler = FlowTraceDownsampler<TcpTraceRecord, Appender> (bucket, Appender (this));
+}
+
+void
+TcpTraceBuffer::OpenFile (const std::string &fileName)
+{
+  m_fileName = fileName;
+  m_file = std::fopen (fileName.c_str (), "wb");
+  NS_ABORT_MSG_IF (m_file == 0, "Cannot open TCP trace file " << fileName);
+  std::fwrite (&m_flow, sizeof (m_flow), 1, m_file);
+}
+
+bool
+TcpTraceBuffer::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+void
+TcpTraceBuffer::Flush (void)
+{
+  if (m_size == 0)
+    {
+      return;
+    }
+  NS_LOG_FUNCTION (this << m_size);
+
+  FlowTraceBlockHeader header;
+  header.count = m_size;
+  m_block.clear ();
+
+  int64_t lastTime = 0;
+  for (uint32_t i = 0; i < m_size; i++)
+    {
+      FlowTracePutVarint (m_block, m_records[i].time - lastTime);
+      lastTime = m_records[i].time;
+    }
+  header.timeBytes = m_block.size ();
+
+  int64_t last = 0;
+  for (uint32_t i = 0; i < m_size; i++)
+    {
+      FlowTracePutVarint (m_block, FlowTraceZigZag (static_cast<int64_t> (m_records[i].cwnd) - last));
+      last = m_records[i].cwnd;
+    }
+  header.cwndBytes = m_block.size () - header.timeBytes;
+
+  last = 0;
+  for (uint32_t i = 0; i < m_size; i++)
+    {
+      FlowTracePutVarint (m_block, FlowTraceZigZag (static_cast<int64_t> (m_records[i].ssThresh) - last));
+      last = m_records[i].ssThresh;
+    }
+  header.ssThreshBytes = m_block.size () - header.timeBytes - header.cwndBytes;
+
+  for (uint32_t i = 0; i < m_size; i++)
+    {
+      m_block.push_back (m_records[i].event);
+    }
+
+  std::fwrite (&header, sizeof (header), 1, m_file);
+  std::fwrite (&m_block[0], 1, m_block.size (), m_file);
+  m_size = 0;
+}
+
+void
+TcpTraceBuffer::FlushAll (void)
+{
+  for (std::set<TcpTraceBuffer *>::iterator i = OpenBuffers ().begin (); i != OpenBuffers ().end (); ++i)
+    {
+      (*i)->Flush ();
+      std::fflush ((*i)->m_file);
+    }
+}
+
+void
+TcpTraceBuffer::ReopenAll (const std::string &dir)
+{
+  NS_LOG_FUNCTION (dir);
+  BranchDir () = dir;
+  for (std::set<TcpTraceBuffer *>::iterator i = OpenBuffers ().begin (); i != OpenBuffers ().end (); ++i)
+    {
+      TcpTraceBuffer *buffer = *i;
+      // records of the parent process are already in its file; those of
+      // the unfinished downsampling bucket go to both files
+      buffer->Flush ();
+      std::fclose (buffer->m_file);
+      buffer->OpenFile (BranchFileName (buffer->m_fileName));
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TCP_TRACE_BUFFER_H
+#define TCP_TRACE_BUFFER_H
+
+#include "flow-trace-format.h"
+#include "flow-trace-downsampler.h"
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Fixed-size binary record of the congestion state of a socket.
+ */
+struct TcpTraceRecord
+{
+  /// Event that produced the record
+  enum Event
+  {
+    NEW_ACK = 0,         //!< New ACK received
+    DUP_ACK = 1,         //!< Duplicate ACK received
+    FAST_RETRANSMIT = 2, //!< Third duplicate ACK, fast retransmit
+    RTO = 3              //!< Retransmission timeout
+  };
+
+  int64_t  time;     //!< Simulation time, in nanoseconds
+  uint32_t cwnd;     //!< Congestion window, in bytes
+  uint32_t ssThresh; //!< Slow start threshold, in bytes
+  uint8_t  event;    //!< One of TcpTraceRecord::Event
+  uint8_t  pad[3];   //!< Padding, always zero
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Preallocated per-flow buffer of TcpTraceRecord.
+ *
+ * Records are appended without any formatting or allocation; when the
+ * buffer is full it is encoded as one columnar block of the flow trace
+ * file (see flow-trace-format.h) and filled again from the start.
+ *
+ * With a non-zero bucket, only the records holding the minimum and maximum
+ * cwnd and ssthresh of each bucket of time are kept (see
+ * FlowTraceDownsampler), so the file size depends on the duration of the
+ * flow instead of its number of ACKs.
+ */
+class TcpTraceBuffer
+{
+public:
+  TcpTraceBuffer ();
+  ~TcpTraceBuffer ();
+
+  /**
+   * \brief Start tracing a flow into a file
+   * \param fileName name of the trace file, moved to the directory given
+   * to ReopenAll if it was called
+   * \param flow header identifying the flow, magic included
+   * \param capacity number of records kept in memory between two flushes
+   * \param bucket downsampling bucket width in nanoseconds, 0 to keep every record
+   */
+  void Open (const std::string &fileName, const FlowTraceFileHeader &flow, uint32_t capacity,
+             int64_t bucket = 0);
+
+  /**
+   * \return true if Open has been called
+   */
+  bool IsOpen (void) const;
+
+  /**
+   * \brief Append a record, flushing the buffer first if it is full
+   * \param time simulation time, in nanoseconds
+   * \param cwnd congestion window
+   * \param ssThresh slow start threshold
+   * \param event the TcpTraceRecord::Event
+   */
+  void Record (int64_t time, uint32_t cwnd, uint32_t ssThresh, uint8_t event)
+  {
+    if (m_downsampled)
+      {
+        TcpTraceRecord r;
+        r.time = time;
+        r.cwnd = cwnd;
+        r.ssThresh = ssThresh;
+        r.event = event;
+        m_downsampler.Add (r);
+        return;
+      }
+    if (m_size == m_records.size ())
+      {
+        Flush ();
+      }
+    TcpTraceRecord &r = m_records[m_size++];
+    r.time = time;
+    r.cwnd = cwnd;
+    r.ssThresh = ssThresh;
+    r.event = event;
+  }
+
+  /**
+   * \brief Write the buffered records to the trace file as one block
+   */
+  void Flush (void);
+
+  /**
+   * \brief Flush every open buffer and the stdio buffers of their files
+   *
+   * Called before forking, so that no record is written by both processes.
+   */
+  static void FlushAll (void);
+
+  /**
+   * \brief Continue every open trace in a file of the same name in \p dir
+   *
+   * Called in a forked process: the records written from now on go to its
+   * own files, which start with the flow header again. The buffers opened
+   * afterwards also write into \p dir, whatever the directory of their
+   * file name.
+   */
+  static void ReopenAll (const std::string &dir);
+
+private:
+  TcpTraceBuffer (const TcpTraceBuffer &);
+  TcpTraceBuffer & operator= (const TcpTraceBuffer &);
+
+  /// Sink of the downsampler, appending the kept records to the buffer
+  struct Appender
+  {
+    /// \param b the buffer receiving the records
+    explicit Appender (TcpTraceBuffer *b)
+      : buffer (b)
+    {
+    }
+    /// \param r a kept record
+    void operator() (const TcpTraceRecord &r) const
+    {
+      buffer->Append (r);
+    }
+    TcpTraceBuffer *buffer; //!< Buffer receiving the records
+  };
+  friend struct Appender;
+
+  /// Append a record, flushing the buffer first if it is full
+  void Append (const TcpTraceRecord &r)
+  {
+    if (m_size == m_records.size ())
+      {
+        Flush ();
+      }
+    m_records[m_size++] = r;
+  }
+
+  /// Open the trace file and write the flow header
+  void OpenFile (const std::string &fileName);
+
+  FILE                       *m_file;    //!< Trace file
+  std::string                 m_fileName; //!< Name of the trace file
+  FlowTraceFileHeader         m_flow;    //!< Header of the trace file
+  std::vector<TcpTraceRecord> m_records; //!< Preallocated records
+  uint32_t                    m_size;    //!< Number of valid records
+  std::vector<uint8_t>        m_block;   //!< Encoding buffer, reused by every flush
+  bool                        m_downsampled; //!< Records go through m_downsampler
+  FlowTraceDownsampler<TcpTraceRecord, Appender> m_downsampler; //!< Min/max per bucket
+};
+
+} // namespace ns3
+
+#endif /* TCP_TRACE_BUFFER_H */
@@ -19,6 +19,20 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -27,9 +41,23 @@
  #include "ns3/point-to-point-layout-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/ipv4-static-routing-helper.h"
+#include "ns3/ipv4-list-routing-helper.h"
+#include "ns3/ipv4-nix-vector-helper.h"
+#include "ns3/ipv4-address-generator.h"
+#include "ns3/bounded-pcap-capture.h"
+#include "ns3/tcp-trace-buffer.h"
+#include "ns3/geometric-error-model.h"
+#include "ns3/instrumented-scheduler.h"
+#include "ns3/fq-codel-queue.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
 
 #include "ns3/flow-monitor.h"
 #include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
 
 #define SSTR( x ) dynamic_cast< std::ostringstream & >( \
             ( std::ostringstream() << std::dec << x ) ).str()
@@ -50,6 +78,15 @@ NS_LOG_COMPONENT_DEFINE ("TcpScalableTest");
 
 
 
+/**
+ * Bulk traffic generator with few events.
+ *
+ * The socket send buffer is filled in batches from its send callback, which
+ * TCP calls when ACKs free buffer space, instead of one timer per packet.
+ * All packets share the payload of a single packet. When a data rate is
+ * given, sending is limited by a token bucket holding a burst of packets,
+ * and a blocked sender wakes up once per burst rather than once per packet.
+ */
 class MyApp : public Application 
 {
 public:
@@ -62,15 +99,22 @@ public:
 
   /**
    * Setup the example application.
+   * A data rate of 0 sends as fast as the socket accepts data.
+   */
+  void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate,
+              uint32_t burstPackets = 16);
+
+  /**
+   * Socket used by the application.
    */
-  void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate);
+  Ptr<Socket> GetSocket (void) const;
 
 private:
   virtual void StartApplication (void);
   virtual void StopApplication (void);
 
-  void ScheduleTx (void);
-  void SendPacket (void);
+  void TxAvailable (Ptr<Socket> socket, uint32_t available);
+  void SendBatch (void);
 
   Ptr<Socket>     m_socket;
   Address         m_peer;
@@ -80,6 +124,11 @@ private:
   EventId         m_sendEvent;
   bool            m_running;
   uint32_t        m_packetsSent;
+  Ptr<Packet>     m_payload;
+  // token bucket, in bytes
+  double          m_tokens;
+  double          m_bucketSize;
+  Time            m_lastRefill;
 };
 
 /**
@@ -93,159 +142,2450 @@ MyApp::MyApp ()
     m_dataRate (0), 
     m_sendEvent (), 
     m_running (false), 
-    m_packetsSent (0)
+    m_packetsSent (0),
+    m_tokens (0),
+    m_bucketSize (0)
+{
+}
+
+/**
+ * Default deconstructor.
+ */
+MyApp::~MyApp()
+{
+  m_socket = 0;
+}
+
+/**
+ * Setup the application.
+ * Parameters:
+ * socket       Socket to send data to.
+ * address      Address to send data to.
+ * packetSize   Size of the packets to send.
+ * nPackets     Number of packets to send.
+ * dataRate     Average rate of the packets, 0 for no limit.
+ * burstPackets Packets sent back to back when the rate allows it.
+ */
+void
+MyApp::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate,
+              uint32_t burstPackets)
+{
+  m_socket = socket;
+  m_peer = address;
+  m_packetSize = packetSize;
+  m_nPackets = nPackets;
+  m_dataRate = dataRate;
+  m_payload = Create<Packet> (m_packetSize);
+  m_bucketSize = static_cast<double> (m_packetSize) * std::max<uint32_t> (burstPackets, 1);
+}
+
+Ptr<Socket>
+MyApp::GetSocket (void) const
+{
+  return m_socket;
+}
+
+/**
+ * Start sending data to the address given in the Setup method.
+ */
+void
+MyApp::StartApplication (void)
+{
+  m_running = true;
+  m_packetsSent = 0;
+  m_tokens = m_bucketSize;
+  m_lastRefill = Simulator::Now ();
+  m_socket->Bind ();
+  m_socket->Connect (m_peer);
+  m_socket->SetSendCallback (MakeCallback (&MyApp::TxAvailable, this));
+  SendBatch ();
+}
+
+/**
+ * Stop sending data to the address given in the Setup method.
+ */
+void 
+MyApp::StopApplication (void)
+{
+  m_running = false;
+
+  if (m_sendEvent.IsRunning ())
+    {
+      Simulator::Cancel (m_sendEvent);
+    }
+
+  if (m_socket)
+    {
+      m_socket->Close ();
+    }
+}
+
+/**
+ * Called by the socket when ACKs freed room in its send buffer.
+ */
+void
+MyApp::TxAvailable (Ptr<Socket> socket, uint32_t available)
+{
+  // a pending wakeup means the rate, not the buffer, is the limit
+  if (!m_sendEvent.IsRunning ())
+    {
+      SendBatch ();
+    }
+}
+
+/**
+ * Send as many packets as the send buffer and the token bucket allow.
+ */
+void 
+MyApp::SendBatch (void)
+{
+  if (!m_running || m_packetsSent >= m_nPackets)
+    {
+      return;
+    }
+
+  bool limited = m_dataRate.GetBitRate () > 0;
+  if (limited)
+    {
+      Time now = Simulator::Now ();
+      m_tokens = std::min (m_bucketSize, m_tokens + (now - m_lastRefill).GetSeconds () * m_dataRate.GetBitRate () / 8);
+      m_lastRefill = now;
+    }
+
+  while (m_packetsSent < m_nPackets && m_socket->GetTxAvailable () >= m_packetSize
+         && (!limited || m_tokens >= m_packetSize))
+    {
+      if (m_socket->Send (m_payload->Copy ()) < 0)
+        {
+          break;
+        }
+      m_packetsSent++;
+      m_tokens -= m_packetSize;
+    }
+
+  if (m_packetsSent >= m_nPackets)
+    {
+      std::cout << "Done sending packets: " << m_packetsSent << std::endl;
+    }
+  else if (limited && m_tokens < m_packetSize)
+    {
+      // wake up once the bucket is full again, or with just enough tokens
+      // for the remaining packets
+      double wanted = std::min (m_bucketSize, static_cast<double> (m_nPackets - m_packetsSent) * m_packetSize);
+      Time wait = Seconds ((wanted - m_tokens) * 8 / m_dataRate.GetBitRate ());
+      m_sendEvent = Simulator::Schedule (wait, &MyApp::SendBatch, this);
+    }
+  // otherwise the send buffer is full and TxAvailable resumes sending
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/**
+ * Periodic export of FlowMonitor statistics.
+ *
+ * Every interval, the change of each flow's counters since the last export
+ * is appended to a CSV file. The delay of every received packet is counted
+ * by the FlowMonitor in its per-flow delay histogram, whose bins are made
+ * bucketWidth wide and folded into nBuckets buckets when written. Memory
+ * only depends on the number of flows and on the largest delay, not on the
+ * length of the run.
+ *
+ * Lines are "F,flow,src,dst,srcPort,dstPort,protocol" the first time a flow
+ * is seen and then
+ * "D,time,flow,txBytes,rxBytes,txPackets,rxPackets,lostPackets,delaySum,jitterSum"
+ * with the deltas of the interval (delays in seconds).
+ */
+class FlowStatsExporter
+{
+public:
+  FlowStatsExporter (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier,
+                     Time interval, const std::string &fileName,
+                     Time bucketWidth, uint32_t nBuckets);
+
+  /**
+   * Write the per-packet delay histograms, one "flow,bucketStart,count"
+   * line per non-empty bucket. The last bucket counts all the larger delays.
+   */
+  void WriteHistograms (const std::string &fileName) const;
+
+  /**
+   * Continue the export in another file, used by forked branches.
+   */
+  void Reopen (const std::string &fileName);
+
+private:
+  void Export (void);
+
+  Ptr<FlowMonitor>        m_monitor;
+  Ptr<Ipv4FlowClassifier> m_classifier;
+  Time                    m_interval;
+  std::ofstream           m_out;
+  Time                    m_bucketWidth;
+  uint32_t                m_nBuckets;
+  std::map<FlowId, FlowMonitor::FlowStats> m_last;
+};
+
+FlowStatsExporter::FlowStatsExporter (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier,
+                                      Time interval, const std::string &fileName,
+                                      Time bucketWidth, uint32_t nBuckets)
+  : m_monitor (monitor),
+    m_classifier (classifier),
+    m_interval (interval),
+    m_out (fileName.c_str ()),
+    m_bucketWidth (bucketWidth),
+    m_nBuckets (nBuckets)
+{
+  // applies to the flows seen from now on, so before the first packet
+  m_monitor->SetAttribute ("DelayBinWidth", DoubleValue (m_bucketWidth.GetSeconds ()));
+  Simulator::Schedule (m_interval, &FlowStatsExporter::Export, this);
+}
+
+void
+FlowStatsExporter::Export (void)
+{
+  m_monitor->CheckForLostPackets ();
+  const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      std::map<FlowId, FlowMonitor::FlowStats>::iterator last = m_last.find (i->first);
+      if (last == m_last.end ())
+        {
+          Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow (i->first);
+          m_out << "F," << i->first << "," << t.sourceAddress << "," << t.destinationAddress << ","
+                << t.sourcePort << "," << t.destinationPort << "," << uint32_t (t.protocol) << "\n";
+          FlowMonitor::FlowStats zero;
+          zero.delaySum = Seconds (0);
+          zero.jitterSum = Seconds (0);
+          zero.txBytes = zero.rxBytes = 0;
+          zero.txPackets = zero.rxPackets = zero.lostPackets = 0;
+          last = m_last.insert (std::make_pair (i->first, zero)).first;
+        }
+
+      const FlowMonitor::FlowStats &now = i->second;
+      FlowMonitor::FlowStats &before = last->second;
+      m_out << "D," << Simulator::Now ().GetSeconds () << "," << i->first << ","
+            << now.txBytes - before.txBytes << "," << now.rxBytes - before.rxBytes << ","
+            << now.txPackets - before.txPackets << "," << now.rxPackets - before.rxPackets << ","
+            << now.lostPackets - before.lostPackets << ","
+            << (now.delaySum - before.delaySum).GetSeconds () << ","
+            << (now.jitterSum - before.jitterSum).GetSeconds () << "\n";
+
+      // Only the counters are kept, not the FlowMonitor histograms
+      before.delaySum = now.delaySum;
+      before.jitterSum = now.jitterSum;
+      before.txBytes = now.txBytes;
+      before.rxBytes = now.rxBytes;
+      before.txPackets = now.txPackets;
+      before.rxPackets = now.rxPackets;
+      before.lostPackets = now.lostPackets;
+    }
+  m_out.flush ();
+  Simulator::Schedule (m_interval, &FlowStatsExporter::Export, this);
+}
+
+void
+FlowStatsExporter::Reopen (const std::string &fileName)
+{
+  m_out.close ();
+  m_out.open (fileName.c_str ());
+  // flows are described again in the new file
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = m_last.begin (); i != m_last.end (); ++i)
+    {
+      Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow (i->first);
+      m_out << "F," << i->first << "," << t.sourceAddress << "," << t.destinationAddress << ","
+            << t.sourcePort << "," << t.destinationPort << "," << uint32_t (t.protocol) << "\n";
+    }
+}
+
+void
+FlowStatsExporter::WriteHistograms (const std::string &fileName) const
+{
+  std::ofstream out (fileName.c_str ());
+  out << "flow,bucketStart,count" << std::endl;
+  const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      const Histogram &delays = i->second.delayHistogram;
+      std::vector<uint32_t> buckets (m_nBuckets, 0);
+      for (uint32_t b = 0; b < delays.GetNBins (); b++)
+        {
+          buckets[std::min (b, m_nBuckets - 1)] += delays.GetBinCount (b);
+        }
+      for (uint32_t b = 0; b < m_nBuckets; b++)
+        {
+          if (buckets[b] > 0)
+            {
+              out << i->first << "," << m_bucketWidth.GetSeconds () * b << "," << buckets[b] << std::endl;
+            }
+        }
+    }
+}
+
+/**
+ * Batch means estimate of the mean of a metric and of the half-width of its
+ * 95% confidence interval, computed online from the batch values.
+ */
+class BatchMeans
+{
+public:
+  BatchMeans ()
+    : m_n (0),
+      m_sum (0),
+      m_sumSquares (0)
+  {
+  }
+
+  void Add (double value)
+  {
+    m_n++;
+    m_sum += value;
+    m_sumSquares += value * value;
+  }
+
+  uint32_t GetN (void) const
+  {
+    return m_n;
+  }
+
+  double GetMean (void) const
+  {
+    return m_n > 0 ? m_sum / m_n : 0;
+  }
+
+  double GetHalfWidth (void) const
+  {
+    if (m_n < 2)
+      {
+        return std::numeric_limits<double>::infinity ();
+      }
+    // Student t quantiles (97.5%) for 1 to 30 degrees of freedom
+    static const double t[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    double mean = GetMean ();
+    double variance = std::max (0.0, (m_sumSquares - m_n * mean * mean) / (m_n - 1));
+    double quantile = m_n - 1 <= 30 ? t[m_n - 2] : 1.96;
+    return quantile * std::sqrt (variance / m_n);
+  }
+
+private:
+  uint32_t m_n;
+  double   m_sum;
+  double   m_sumSquares;
+};
+
+/**
+ * Socket of a sender, BulkSendApplication, OnOffApplication or MyApp; 0
+ * until the application has started, except for MyApp.
+ */
+static Ptr<Socket>
+GetSenderSocket (Ptr<Application> sender)
+{
+  Ptr<BulkSendApplication> bulk = DynamicCast<BulkSendApplication> (sender);
+  if (bulk)
+    {
+      return bulk->GetSocket ();
+    }
+  Ptr<OnOffApplication> onOff = DynamicCast<OnOffApplication> (sender);
+  return onOff ? onOff->GetSocket () : DynamicCast<MyApp> (sender)->GetSocket ();
+}
+
+/**
+ * Set a string attribute of the socket of a sender once it has started.
+ * The first call runs at the start time but before the start of the
+ * application, scheduled at the same time once the simulation runs, so it
+ * goes through the event queue once more.
+ */
+static void
+SetStartedSocketAttribute (Ptr<Application> sender, std::string name, std::string value, bool started)
+{
+  if (!started)
+    {
+      Simulator::ScheduleNow (&SetStartedSocketAttribute, sender, name, value, true);
+      return;
+    }
+  Ptr<Socket> socket = GetSenderSocket (sender);
+  if (socket)
+    {
+      // sockets without it, e.g. NSC ones, are skipped
+      socket->SetAttributeFailSafe (name, StringValue (value));
+    }
+}
+
+/**
+ * Set a string attribute of the sockets of some senders, rather than its
+ * default for every socket of the process. To be called before the
+ * simulation runs.
+ */
+static void
+SetSenderSocketAttribute (const ApplicationContainer &senders, const std::string &name, const std::string &value)
+{
+  for (uint32_t i = 0; i < senders.GetN (); i++)
+    {
+      Ptr<Socket> socket = GetSenderSocket (senders.Get (i));
+      if (socket)
+        {
+          socket->SetAttributeFailSafe (name, StringValue (value));
+          continue;
+        }
+      TimeValue start;
+      senders.Get (i)->GetAttribute ("StartTime", start);
+      Simulator::Schedule (start.Get (), &SetStartedSocketAttribute, senders.Get (i), name, value, false);
+    }
+}
+
+/**
+ * Default of an attribute, "<TypeId>::<attribute>", as a string; empty if
+ * there is no such attribute.
+ */
+static std::string
+GetAttributeDefault (const std::string &name)
+{
+  std::string::size_type separator = name.rfind ("::");
+  TypeId tid;
+  struct TypeId::AttributeInformation info;
+  if (separator == std::string::npos
+      || !TypeId::LookupByNameFailSafe (name.substr (0, separator), &tid)
+      || !tid.LookupAttributeByName (name.substr (separator + 2), &info))
+    {
+      return "";
+    }
+  return info.initialValue->SerializeToString (info.checker);
+}
+
+/**
+ * Sum of an unsigned socket attribute over the senders of the bulk flows,
+ * skipping the sockets which do not have it (e.g. other TCP variants).
+ */
+static uint64_t
+SumSenderAttribute (const ApplicationContainer &senders, const std::string &name)
+{
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < senders.GetN (); i++)
+    {
+      Ptr<Socket> socket = GetSenderSocket (senders.Get (i));
+      UintegerValue value;
+      if (socket && socket->GetAttributeFailSafe (name, value))
+        {
+          sum += value.Get ();
+        }
+    }
+  return sum;
+}
+
+/**
+ * Stops the simulation once the goodput of the bulk flow and the
+ * congestion window of its sender are in a steady state.
+ *
+ * After a warm-up, the goodput and the time-averaged cwnd of every batch
+ * interval are fed to batch means estimators. The simulation is stopped as
+ * soon as the confidence interval of both means is narrower than a fraction
+ * of the mean, with at least a minimal number of batches. No batch is cut
+ * past the stop time of the sender, whose idle tail would pull the goodput
+ * mean down.
+ */
+class ConvergenceMonitor
+{
+public:
+  ConvergenceMonitor (Ptr<PacketSink> sink, Ptr<Application> sender, Time senderStop,
+                      Time warmup, Time batchInterval, double ciTarget, uint32_t minBatches);
+
+  /**
+   * \return true if the simulation was stopped by the monitor
+   */
+  bool HasConverged (void) const;
+
+  /**
+   * Print why and when the simulation stopped, and the estimated means.
+   */
+  void Report (void) const;
+
+private:
+  void Start (void);
+  void EndBatch (void);
+  void CwndChange (uint32_t oldCwnd, uint32_t newCwnd);
+
+  Ptr<PacketSink>          m_sink;
+  Ptr<Application>         m_sender;
+  Time                     m_senderStop;
+  Time                     m_batchInterval;
+  double                   m_ciTarget;
+  uint32_t                 m_minBatches;
+
+  uint64_t   m_lastRx;
+  uint32_t   m_cwnd;
+  bool       m_cwndKnown;
+  bool       m_firstBatchDone;
+  Time       m_cwndChange;
+  double     m_cwndIntegral;
+  BatchMeans m_goodput;
+  BatchMeans m_cwndMean;
+  bool       m_converged;
+  Time       m_stopTime;
+};
+
+ConvergenceMonitor::ConvergenceMonitor (Ptr<PacketSink> sink, Ptr<Application> sender, Time senderStop,
+                                        Time warmup, Time batchInterval, double ciTarget, uint32_t minBatches)
+  : m_sink (sink),
+    m_sender (sender),
+    m_senderStop (senderStop),
+    m_batchInterval (batchInterval),
+    m_ciTarget (ciTarget),
+    m_minBatches (std::max<uint32_t> (minBatches, 2)),
+    m_lastRx (0),
+    m_cwnd (0),
+    m_cwndKnown (false),
+    m_firstBatchDone (false),
+    m_cwndIntegral (0),
+    m_converged (false)
+{
+  Simulator::Schedule (warmup, &ConvergenceMonitor::Start, this);
+}
+
+void
+ConvergenceMonitor::Start (void)
+{
+  // the socket of BulkSendApplication only exists once it started
+  Ptr<Socket> socket = GetSenderSocket (m_sender);
+  NS_ABORT_MSG_IF (socket == 0, "Convergence warm-up ends before the bulk sender starts");
+  socket->TraceConnectWithoutContext ("CongestionWindow", MakeCallback (&ConvergenceMonitor::CwndChange, this));
+  m_lastRx = m_sink->GetTotalRx ();
+  if (Simulator::Now () + m_batchInterval <= m_senderStop)
+    {
+      Simulator::Schedule (m_batchInterval, &ConvergenceMonitor::EndBatch, this);
+    }
+}
+
+void
+ConvergenceMonitor::CwndChange (uint32_t oldCwnd, uint32_t newCwnd)
+{
+  if (m_cwndKnown)
+    {
+      m_cwndIntegral += m_cwnd * (Simulator::Now () - m_cwndChange).GetSeconds ();
+    }
+  m_cwnd = newCwnd;
+  m_cwndKnown = true;
+  m_cwndChange = Simulator::Now ();
+}
+
+void
+ConvergenceMonitor::EndBatch (void)
+{
+  uint64_t rx = m_sink->GetTotalRx ();
+  if (m_cwndKnown && m_firstBatchDone)
+    {
+      CwndChange (m_cwnd, m_cwnd);
+      m_goodput.Add ((rx - m_lastRx) * 8.0 / m_batchInterval.GetSeconds ());
+      m_cwndMean.Add (m_cwndIntegral / m_batchInterval.GetSeconds ());
+    }
+  else
+    {
+      // the cwnd is only known from its first change, so the first batch
+      // has no valid average and is dropped
+      m_cwndChange = Simulator::Now ();
+    }
+  m_firstBatchDone = m_cwndKnown;
+  m_lastRx = rx;
+  m_cwndIntegral = 0;
+
+  if (m_goodput.GetN () >= m_minBatches
+      && m_goodput.GetHalfWidth () <= m_ciTarget * m_goodput.GetMean ()
+      && m_cwndMean.GetHalfWidth () <= m_ciTarget * m_cwndMean.GetMean ())
+    {
+      m_converged = true;
+      m_stopTime = Simulator::Now ();
+      Simulator::Stop ();
+      return;
+    }
+  if (Simulator::Now () + m_batchInterval <= m_senderStop)
+    {
+      Simulator::Schedule (m_batchInterval, &ConvergenceMonitor::EndBatch, this);
+    }
+}
+
+bool
+ConvergenceMonitor::HasConverged (void) const
 {
+  return m_converged;
+}
+
+void
+ConvergenceMonitor::Report (void) const
+{
+  if (m_converged)
+    {
+      NS_LOG_UNCOND ("Converged at " << m_stopTime.GetSeconds () << "s after " << m_goodput.GetN ()
+                     << " batches: goodput " << m_goodput.GetMean () / 1000 << " +- "
+                     << m_goodput.GetHalfWidth () / 1000 << " kbps, cwnd " << m_cwndMean.GetMean ()
+                     << " +- " << m_cwndMean.GetHalfWidth () << " bytes");
+    }
+  else
+    {
+      NS_LOG_UNCOND ("Not converged after " << m_goodput.GetN () << " batches: goodput half-width "
+                     << m_goodput.GetHalfWidth () / 1000 << " kbps, cwnd half-width "
+                     << m_cwndMean.GetHalfWidth () << " bytes");
+    }
+}
+
+/**
+ * Background traffic as a fluid: instead of sending packets, the cross
+ * traffic takes its rate out of the capacity of every device on its path,
+ * and the share of their queue its packets would hold.
+ *
+ * The path is found once from the routing tables. Every update interval,
+ * the backlog the background packets would have in each queue is estimated
+ * by Little's law, from their arrival rate and the current queueing delay,
+ * and removed from the queue limit, so that packet flows sharing the
+ * devices see both the lower service rate and the earlier drops. The fluid
+ * is open loop: unlike the TCP OnOff flow of the packet mode, it does not
+ * back off on losses.
+ */
+class FluidBackground
+{
+public:
+  FluidBackground (Ptr<Node> source, Ipv4Address destination, DataRate rate, uint32_t packetSize,
+                   Time interval, Time start, Time stop);
+
+  /**
+   * Change the rate of the background traffic from now on.
+   */
+  void SetRate (DataRate rate);
+
+  /**
+   * Bytes the background traffic carried so far.
+   */
+  uint64_t GetTotalBytes (void) const;
+
+private:
+  struct Hop
+  {
+    Ptr<PointToPointNetDevice> device;
+    DataRate                   capacity;
+    uint32_t                   maxPackets;
+  };
+
+  void Start (void);
+  void Stop (void);
+  void Update (void);
+  /// Integrate the rate up to now
+  void Account (void);
+
+  std::vector<Hop> m_path;
+  DataRate         m_rate;
+  uint32_t         m_packetSize;
+  Time             m_interval;
+  bool             m_active;
+  Time             m_lastAccount;
+  double           m_totalBytes;
+  EventId          m_updateEvent;
+};
+
+FluidBackground::FluidBackground (Ptr<Node> source, Ipv4Address destination, DataRate rate, uint32_t packetSize,
+                                  Time interval, Time start, Time stop)
+  : m_rate (rate),
+    m_packetSize (packetSize),
+    m_interval (interval),
+    m_active (false),
+    m_totalBytes (0)
+{
+  // Follow the routes hop by hop, as a packet of the flow would.
+  Ptr<Node> node = source;
+  while (node->GetObject<Ipv4> ()->GetInterfaceForAddress (destination) < 0)
+    {
+      NS_ABORT_MSG_IF (m_path.size () > NodeList::GetNNodes (), "Routing loop towards " << destination);
+      Ipv4Header header;
+      header.SetDestination (destination);
+      header.SetProtocol (TcpL4Protocol::PROT_NUMBER);
+      Socket::SocketErrno error;
+      Ptr<Ipv4Route> route = node->GetObject<Ipv4> ()->GetRoutingProtocol ()
+        ->RouteOutput (Create<Packet> (), header, 0, error);
+      NS_ABORT_MSG_IF (route == 0, "No route from node " << node->GetId () << " to " << destination);
+
+      Hop hop;
+      hop.device = DynamicCast<PointToPointNetDevice> (route->GetOutputDevice ());
+      NS_ABORT_MSG_IF (hop.device == 0, "The fluid background only crosses point-to-point links");
+      DataRateValue capacity;
+      hop.device->GetAttribute ("DataRate", capacity);
+      hop.capacity = capacity.Get ();
+      UintegerValue maxPackets;
+      hop.device->GetQueue ()->GetAttribute ("MaxPackets", maxPackets);
+      hop.maxPackets = maxPackets.Get ();
+      m_path.push_back (hop);
+
+      Ptr<Channel> channel = hop.device->GetChannel ();
+      Ptr<NetDevice> peer = channel->GetDevice (0) == hop.device ? channel->GetDevice (1) : channel->GetDevice (0);
+      node = peer->GetNode ();
+    }
+  NS_LOG_UNCOND (">> Fluid background of " << m_rate << " over " << m_path.size () << " hops");
+
+  Simulator::Schedule (start, &FluidBackground::Start, this);
+  Simulator::Schedule (stop, &FluidBackground::Stop, this);
+}
+
+void
+FluidBackground::SetRate (DataRate rate)
+{
+  Account ();
+  m_rate = rate;
+  if (m_active)
+    {
+      m_updateEvent.Cancel ();
+      Update ();
+    }
+}
+
+uint64_t
+FluidBackground::GetTotalBytes (void) const
+{
+  double bytes = m_totalBytes;
+  if (m_active)
+    {
+      bytes += (Simulator::Now () - m_lastAccount).GetSeconds () * m_rate.GetBitRate () / 8;
+    }
+  return static_cast<uint64_t> (bytes);
+}
+
+void
+FluidBackground::Account (void)
+{
+  if (m_active)
+    {
+      m_totalBytes += (Simulator::Now () - m_lastAccount).GetSeconds () * m_rate.GetBitRate () / 8;
+    }
+  m_lastAccount = Simulator::Now ();
+}
+
+void
+FluidBackground::Start (void)
+{
+  Account ();
+  m_active = true;
+  Update ();
+}
+
+void
+FluidBackground::Stop (void)
+{
+  Account ();
+  m_active = false;
+  m_updateEvent.Cancel ();
+  for (size_t i = 0; i < m_path.size (); i++)
+    {
+      m_path[i].device->SetDataRate (m_path[i].capacity);
+      m_path[i].device->GetQueue ()->SetAttribute ("MaxPackets", UintegerValue (m_path[i].maxPackets));
+    }
+}
+
+void
+FluidBackground::Update (void)
+{
+  for (size_t i = 0; i < m_path.size (); i++)
+    {
+      const Hop &hop = m_path[i];
+      // keep a sliver of capacity for the packets even when overloaded
+      uint64_t capacity = hop.capacity.GetBitRate ();
+      uint64_t residual = std::max (capacity - std::min (m_rate.GetBitRate (), capacity), capacity / 100);
+      hop.device->SetDataRate (DataRate (residual));
+
+      Ptr<Queue> queue = hop.device->GetQueue ();
+      uint32_t bytes = queue->GetNBytes ();
+      double delay = bytes * 8.0 / residual;
+      double backlog = m_rate.GetBitRate () / (8.0 * m_packetSize) * delay;
+      uint32_t maxPackets = hop.maxPackets - std::min<uint32_t> (static_cast<uint32_t> (backlog + 0.5), hop.maxPackets - 1);
+      queue->SetAttribute ("MaxPackets", UintegerValue (maxPackets));
+    }
+  m_updateEvent = Simulator::Schedule (m_interval, &FluidBackground::Update, this);
+}
+
+/**
+ * Retransmissions and flight size of the TCP flows sending data from some
+ * nodes, read from the IP layer of the senders. NSC sockets have no trace
+ * sources for them, so both stacks of --tcp=both are measured this way.
+ *
+ * A data segment starting below the highest sequence number sent so far
+ * on its flow is a retransmission. The flight size is the highest
+ * sequence sent minus the highest ACK received; the bulk senders are never
+ * application limited, so outside of recoveries it is their cwnd. Every
+ * interval, one "time,srcPort,dst,dstPort,flightBytes" line per flow is
+ * written.
+ */
+class TcpWireMonitor
+{
+public:
+  TcpWireMonitor (Time interval, const std::string &fileName);
+
+  /**
+   * Watch the flows sending data from a node.
+   */
+  void Install (Ptr<Node> node);
+
+  uint64_t GetRetransmittedSegments (void) const;
+  uint64_t GetRetransmittedBytes (void) const;
+
+private:
+  /// Fields of a TCP/IPv4 packet, from its raw bytes
+  struct Segment
+  {
+    Ipv4Address      src;
+    Ipv4Address      dst;
+    uint16_t         srcPort;
+    uint16_t         dstPort;
+    SequenceNumber32 seq;
+    SequenceNumber32 ack;
+    bool             hasAck;
+    uint32_t         payload;
+  };
+
+  struct Flow
+  {
+    SequenceNumber32 highTx;
+    SequenceNumber32 highAck;
+    bool             acked;
+  };
+
+  /// Flows by local port, remote address and port
+  typedef std::map<std::pair<uint16_t, std::pair<uint32_t, uint16_t> >, Flow> FlowMap;
+
+  static bool Parse (Ptr<const Packet> packet, Segment &segment);
+  void Tx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+  void Rx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+  void Sample (void);
+
+  Time          m_interval;
+  std::ofstream m_file;
+  FlowMap       m_flows;
+  uint64_t      m_retransmittedSegments;
+  uint64_t      m_retransmittedBytes;
+};
+
+TcpWireMonitor::TcpWireMonitor (Time interval, const std::string &fileName)
+  : m_interval (interval),
+    m_file (fileName.c_str ()),
+    m_retransmittedSegments (0),
+    m_retransmittedBytes (0)
+{
+  m_file << "time,srcPort,dst,dstPort,flightBytes" << std::endl;
+  Simulator::Schedule (m_interval, &TcpWireMonitor::Sample, this);
+}
+
+void
+TcpWireMonitor::Install (Ptr<Node> node)
+{
+  Ptr<Ipv4L3Protocol> ipv4 = node->GetObject<Ipv4L3Protocol> ();
+  ipv4->TraceConnectWithoutContext ("Tx", MakeCallback (&TcpWireMonitor::Tx, this));
+  ipv4->TraceConnectWithoutContext ("Rx", MakeCallback (&TcpWireMonitor::Rx, this));
+}
+
+uint64_t
+TcpWireMonitor::GetRetransmittedSegments (void) const
+{
+  return m_retransmittedSegments;
+}
+
+uint64_t
+TcpWireMonitor::GetRetransmittedBytes (void) const
+{
+  return m_retransmittedBytes;
+}
+
+bool
+TcpWireMonitor::Parse (Ptr<const Packet> packet, Segment &segment)
+{
+  // The headers are read from the bytes, as NSC hands its segments over
+  // already serialized.
+  uint8_t buffer[60 + 20];
+  uint32_t length = packet->CopyData (buffer, sizeof (buffer));
+  if (length < 20 || buffer[9] != TcpL4Protocol::PROT_NUMBER)
+    {
+      return false;
+    }
+  uint32_t ipLength = (buffer[0] & 0x0f) * 4;
+  if (length < ipLength + 20)
+    {
+      return false;
+    }
+  const uint8_t *tcp = buffer + ipLength;
+  uint32_t tcpLength = (tcp[12] >> 4) * 4;
+  uint32_t totalLength = (buffer[2] << 8) | buffer[3];
+  segment.src = Ipv4Address::Deserialize (buffer + 12);
+  segment.dst = Ipv4Address::Deserialize (buffer + 16);
+  segment.srcPort = (tcp[0] << 8) | tcp[1];
+  segment.dstPort = (tcp[2] << 8) | tcp[3];
+  segment.seq = SequenceNumber32 ((uint32_t (tcp[4]) << 24) | (tcp[5] << 16) | (tcp[6] << 8) | tcp[7]);
+  segment.ack = SequenceNumber32 ((uint32_t (tcp[8]) << 24) | (tcp[9] << 16) | (tcp[10] << 8) | tcp[11]);
+  segment.hasAck = tcp[13] & TcpHeader::ACK;
+  segment.payload = totalLength > ipLength + tcpLength ? totalLength - ipLength - tcpLength : 0;
+  return true;
+}
+
+void
+TcpWireMonitor::Tx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+  Segment segment;
+  if (!Parse (packet, segment) || segment.payload == 0)
+    {
+      return;
+    }
+  FlowMap::key_type key (segment.srcPort, std::make_pair (segment.dst.Get (), segment.dstPort));
+  SequenceNumber32 end = segment.seq + segment.payload;
+  FlowMap::iterator i = m_flows.find (key);
+  if (i == m_flows.end ())
+    {
+      // the first segment seen starts the flow, and goes through the same
+      // checks as the next ones
+      Flow flow;
+      flow.highTx = segment.seq;
+      flow.acked = false;
+      i = m_flows.insert (std::make_pair (key, flow)).first;
+    }
+  if (segment.seq < i->second.highTx)
+    {
+      m_retransmittedSegments++;
+      m_retransmittedBytes += segment.payload;
+    }
+  if (end > i->second.highTx)
+    {
+      i->second.highTx = end;
+    }
+}
+
+void
+TcpWireMonitor::Rx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+  Segment segment;
+  if (!Parse (packet, segment) || !segment.hasAck)
+    {
+      return;
+    }
+  FlowMap::iterator i = m_flows.find (FlowMap::key_type (segment.dstPort, std::make_pair (segment.src.Get (), segment.srcPort)));
+  if (i == m_flows.end ())
+    {
+      return;
+    }
+  if (!i->second.acked || segment.ack > i->second.highAck)
+    {
+      i->second.highAck = segment.ack;
+      i->second.acked = true;
+    }
+}
+
+void
+TcpWireMonitor::Sample (void)
+{
+  double now = Simulator::Now ().GetSeconds ();
+  for (FlowMap::const_iterator i = m_flows.begin (); i != m_flows.end (); ++i)
+    {
+      if (i->second.acked)
+        {
+          m_file << now << "," << i->first.first << "," << Ipv4Address (i->first.second.first) << ","
+                 << i->first.second.second << "," << i->second.highTx - i->second.highAck << std::endl;
+        }
+    }
+  Simulator::Schedule (m_interval, &TcpWireMonitor::Sample, this);
+}
+
+/**
+ * Star of point-to-point links, like PointToPointStarHelper, but with all
+ * its nodes created in one system (MPI rank) of a distributed simulation.
+ */
+class StarNetwork
+{
+public:
+  StarNetwork (uint32_t nSpokes, PointToPointHelper p2pHelper, uint32_t systemId);
+
+  Ptr<Node> GetHub (void) const;
+  Ptr<Node> GetSpokeNode (uint32_t i) const;
+  Ipv4Address GetHubIpv4Address (uint32_t i) const;
+  Ipv4Address GetSpokeIpv4Address (uint32_t i) const;
+  uint32_t SpokeCount (void) const;
+
+  void InstallStack (const InternetStackHelper &stack);
+  /**
+   * Assign addresses to the spoke links, starting a new network for each.
+   */
+  void AssignIpv4Addresses (Ipv4AddressHelper address);
+
+private:
+  NodeContainer          m_hub;
+  NodeContainer          m_spokes;
+  NetDeviceContainer     m_hubDevices;
+  NetDeviceContainer     m_spokeDevices;
+  Ipv4InterfaceContainer m_hubInterfaces;
+  Ipv4InterfaceContainer m_spokeInterfaces;
+};
+
+StarNetwork::StarNetwork (uint32_t nSpokes, PointToPointHelper p2pHelper, uint32_t systemId)
+{
+  m_hub.Create (1, systemId);
+  m_spokes.Create (nSpokes, systemId);
+  for (uint32_t i = 0; i < nSpokes; i++)
+    {
+      NetDeviceContainer devices = p2pHelper.Install (m_hub.Get (0), m_spokes.Get (i));
+      m_hubDevices.Add (devices.Get (0));
+      m_spokeDevices.Add (devices.Get (1));
+    }
+}
+
+Ptr<Node>
+StarNetwork::GetHub (void) const
+{
+  return m_hub.Get (0);
+}
+
+Ptr<Node>
+StarNetwork::GetSpokeNode (uint32_t i) const
+{
+  return m_spokes.Get (i);
+}
+
+Ipv4Address
+StarNetwork::GetHubIpv4Address (uint32_t i) const
+{
+  return m_hubInterfaces.GetAddress (i);
+}
+
+Ipv4Address
+StarNetwork::GetSpokeIpv4Address (uint32_t i) const
+{
+  return m_spokeInterfaces.GetAddress (i);
+}
+
+uint32_t
+StarNetwork::SpokeCount (void) const
+{
+  return m_spokes.GetN ();
+}
+
+void
+StarNetwork::InstallStack (const InternetStackHelper &stack)
+{
+  stack.Install (m_hub);
+  stack.Install (m_spokes);
+}
+
+void
+StarNetwork::AssignIpv4Addresses (Ipv4AddressHelper address)
+{
+  for (uint32_t i = 0; i < m_spokes.GetN (); i++)
+    {
+      m_hubInterfaces.Add (address.Assign (NetDeviceContainer (m_hubDevices.Get (i))));
+      m_spokeInterfaces.Add (address.Assign (NetDeviceContainer (m_spokeDevices.Get (i))));
+      address.NewNetwork ();
+    }
+}
+
+/**
+ * Install an application on a node only if this process simulates it: in a
+ * distributed run every rank builds the whole topology, but only runs the
+ * applications of its own nodes.
+ */
+template <class Helper>
+static ApplicationContainer
+InstallIfLocal (const Helper &helper, Ptr<Node> node, uint32_t rank)
+{
+  if (node->GetSystemId () != rank)
+    {
+      return ApplicationContainer ();
+    }
+  return helper.Install (node);
+}
+
+/**
+ * Fork one child process per branch value, once everything buffered by
+ * this process has been written, so that nothing is written twice.
+ * Returns the index of its value in a child, and -1 in the parent once
+ * all the children have exited.
+ */
+static int
+ForkBranches (const std::vector<std::string> &values)
+{
+  TcpTraceBuffer::FlushAll ();
+  std::cout.flush ();
+  std::clog.flush ();
+  std::fflush (0);
+
+  std::vector<pid_t> children;
+  for (size_t i = 0; i < values.size (); i++)
+    {
+      pid_t pid = fork ();
+      NS_ABORT_MSG_IF (pid < 0, "Cannot fork the branch " << values[i]);
+      if (pid == 0)
+        {
+          return i;
+        }
+      children.push_back (pid);
+    }
+  for (size_t i = 0; i < children.size (); i++)
+    {
+      int status;
+      waitpid (children[i], &status, 0);
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+          NS_LOG_UNCOND ("Branch " << values[i] << " failed");
+        }
+    }
+  return -1;
+}
+
+/**
+ * Create the error model selected by --error-model, corrupting bytes with
+ * probability \p rate: rate (RateErrorModel), geometric or gilbert
+ * (GeometricErrorModel, without or with bursts). Returns 0 for none.
+ */
+static Ptr<ErrorModel>
+CreateErrorModel (const std::string &model, double rate)
+{
+  if (model == "rate")
+    {
+      Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+      em->SetUnit (RateErrorModel::ERROR_UNIT_BYTE);
+      em->SetRate (rate);
+      return em;
+    }
+  if (model == "geometric" || model == "gilbert")
+    {
+      return CreateObjectWithAttributes<GeometricErrorModel> ("ErrorRate", DoubleValue (rate),
+                                                              "GilbertElliott", BooleanValue (model == "gilbert"));
+    }
+  NS_ABORT_MSG_UNLESS (model == "none", "Unknown error model " << model);
+  return 0;
+}
+
+/**
+ * Device receiving the errors: "<node id>:<device index>", or by default
+ * the device of the receiver's star hub on its access link.
+ */
+static Ptr<PointToPointNetDevice>
+FindErrorDevice (const std::string &spec, Ptr<NetDevice> defaultDevice)
+{
+  if (spec.empty ())
+    {
+      return DynamicCast<PointToPointNetDevice> (defaultDevice);
+    }
+  std::string::size_type colon = spec.find (':');
+  NS_ABORT_MSG_IF (colon == std::string::npos, "--errorDevice is <node id>:<device index>");
+  uint32_t nodeId = std::atoi (spec.substr (0, colon).c_str ());
+  uint32_t index = std::atoi (spec.substr (colon + 1).c_str ());
+  NS_ABORT_MSG_UNLESS (nodeId < NodeList::GetNNodes () && index < NodeList::GetNode (nodeId)->GetNDevices (),
+                       "No device " << spec);
+  Ptr<PointToPointNetDevice> device = DynamicCast<PointToPointNetDevice> (NodeList::GetNode (nodeId)->GetDevice (index));
+  NS_ABORT_MSG_IF (device == 0, "Device " << spec << " is not a point-to-point device");
+  return device;
+}
+
+static double
+WallSeconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Write the cost of the run as "benchmark,metric,value" lines, the format
+ * of scratch/tcp-scalable-bench, to compare builds with bench-compare.sh.
+ * rxBytes is there to check that the compared runs did the same thing.
+ * max_rss_kb is the peak of the whole process, so after the first scenario
+ * of a batch or a comparison it includes the peaks of the earlier runs.
+ */
+static void
+WriteBenchReport (const std::string &fileName, double runWall, uint64_t rxBytes)
+{
+  InstrumentedScheduler *scheduler = InstrumentedScheduler::GetCurrent ();
+  NS_ABORT_MSG_IF (scheduler == 0, "The scheduler is not an InstrumentedScheduler");
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  std::ofstream out (fileName.c_str ());
+  out << "benchmark,metric,value" << std::endl
+      << "scenario,events," << scheduler->GetExecuteCount () << std::endl
+      << "scenario,wall_s," << runWall << std::endl
+      << "scenario,events_per_s," << scheduler->GetExecuteCount () / runWall << std::endl
+      << "scenario,peak_pending_events," << scheduler->GetPeakSize () << std::endl
+      << "scenario,max_rss_kb," << usage.ru_maxrss << std::endl
+      << "scenario,rx_bytes," << rxBytes << std::endl;
+}
+
+/**
+ * Write the events of the run ranked by wall-clock time, and the number of
+ * pending events over simulated time next to it.
+ */
+static void
+WriteProfileReport (const std::string &fileName, const std::string &prefix)
+{
+  InstrumentedScheduler *scheduler = InstrumentedScheduler::GetCurrent ();
+  NS_ABORT_MSG_IF (scheduler == 0, "The scheduler is not an InstrumentedScheduler");
+  NS_LOG_UNCOND ("> Most expensive events");
+  scheduler->WriteProfile (prefix + fileName, prefix + "event-queue-depth.csv", 10);
+}
+
+/**
+ * Parameters of one scenario, settable from the command line or from
+ * one line of a --batch file.
+ */
+struct ScenarioConfig
+{
+  ScenarioConfig ();
+
+  /**
+   * Register the scenario options on a command line.
+   */
+  void AddValues (CommandLine &cmd);
+  /**
+   * Abort on the option values no scenario can run with, once parsed.
+   */
+  void Check (void) const;
+  /**
+   * Time the bulk senders send data, from their start at 1 s to their
+   * stop at runtime - 2 s, over which the goodput is computed.
+   */
+  double GetSendTime (void) const;
+
+  // this is the default error rate of our link, that is, the the probability of a single
+  // byte being 'corrupted' during transfer.
+  double errRate;
+  // how long the sender should be running, in seconds.
+  unsigned int runtime;
+
+  std::string backgroundRate;
+  // per-run summary, one CSV row merged by sweep.sh
+  std::string summaryFile;
+  // TCP socket used by every node, one of the TcpAimdSocket variants
+  std::string socketType;
+  // none, rate (RateErrorModel), geometric or gilbert (GeometricErrorModel)
+  std::string errorModel;
+  // "<node id>:<device index>" of the device receiving errors, empty for
+  // the receiver's star hub
+  std::string errorDevice;
+  // full: complete packets of every p2p device, headers: BoundedPcapCapture, none
+  std::string pcapMode;
+  // period of the FlowMonitor export in seconds, 0 to only write results.xml
+  double flowStatsInterval;
+  // width of the delay histogram buckets of the export, in seconds
+  double flowStatsBucket;
+  // stop the run once goodput and cwnd are stable, see ConvergenceMonitor
+  bool converge;
+  // relative half-width of the confidence intervals to reach
+  double ciTarget;
+  // length of the batches, in seconds
+  double batchInterval;
+  // warm-up excluded from the batches, in seconds from the start
+  double minTime;
+  // batches needed before the run can stop
+  uint32_t minBatches;
+  // topology: ring of backbone nodes, stars hanging off the even ones
+  uint32_t ringSize;
+  uint32_t stars;
+  uint32_t spokes;
+  // global: Ipv4GlobalRoutingHelper tables, nix: on-demand nix-vectors
+  std::string routing;
+
+  // simulate up to this time, then fork a branch per value (0: no branches)
+  double branchTime;
+  // parameter changed by the branches: error-rate or bgRate
+  std::string branchParam;
+  // comma separated values of the branch parameter
+  std::string branchValues;
+  // application of the bulk flow: bulk (BulkSendApplication) or batch (MyApp)
+  std::string sender;
+  // rate limit of the batch sender, 0bps for none
+  std::string senderRate;
+  // background traffic: packet (TCP OnOff flow) or fluid (FluidBackground)
+  std::string bgModel;
+  // update period of the fluid background, in seconds
+  double bgFluidInterval;
+
+  // file receiving the events per second and peak memory of the run
+  std::string benchFile;
+
+  // file receiving the wall-clock time spent in each kind of event
+  std::string profileFile;
+  // event scheduler: map, list, heap, calendar or dheap
+  std::string scheduler;
+  // number of parallel bulk flows between the sender and the receiver
+  uint32_t flows;
+  // queue of the devices of each kind of link: droptail, fifo, codel or fqcodel
+  std::string queueEndpoint;
+  std::string queueProvider;
+  std::string queueBackbone;
+  // scenario file replacing the built-in topology and applications
+  std::string scenarioFile;
+  // TCP of the nodes: scalable (socketType), nsc (Linux through NSC), or
+  // both to run the scenario once with each
+  std::string tcp;
+  // NSC library and the congestion control of its bulk senders
+  std::string nscLibrary;
+  std::string nscCongestion;
+  // measure retransmissions and flight size of the bulk senders on the wire
+  bool wireStats;
+  double wireInterval;
+  // one line of TcpFlowStats per TcpAimdSocket flow in tcp-stats.csv
+  bool tcpStats;
+
+  // MPI rank of this process and number of ranks, set by main in
+  // distributed mode (not options)
+  uint32_t rank;
+  uint32_t ranks;
+  // attribute defaults and global values of the command line, set by main
+  // to start the runs of --tcp=both from the same state (not options)
+  std::vector<std::string> attributeArgs;
+};
+
+/**
+ * What a scenario run measured, for the runs compared by --tcp=both.
+ */
+struct ScenarioResult
+{
+  ScenarioResult ();
+
+  uint64_t rxBytes;
+  double   goodputKbps;
+  // measured on the wire, see TcpWireMonitor
+  uint64_t retransmittedSegments;
+  uint64_t retransmittedBytes;
+  // events executed, 0 without an InstrumentedScheduler
+  uint64_t events;
+  double   wallSeconds;
+  double   simSeconds;
+};
+
+ScenarioResult::ScenarioResult ()
+  : rxBytes (0),
+    goodputKbps (0),
+    retransmittedSegments (0),
+    retransmittedBytes (0),
+    events (0),
+    wallSeconds (0),
+    simSeconds (0)
+{
+}
+
+ScenarioConfig::ScenarioConfig ()
+  : errRate (0.000001),
+    runtime (300),
+    backgroundRate ("10kbps"),
+    summaryFile ("summary.csv"),
+    socketType ("ns3::TcpScalable"),
+    errorModel ("none"),
+    pcapMode ("full"),
+    flowStatsInterval (0),
+    flowStatsBucket (0.01),
+    converge (false),
+    ciTarget (0.05),
+    batchInterval (5),
+    minTime (20),
+    minBatches (10),
+    ringSize (4),
+    stars (2),
+    spokes (3),
+    routing ("global"),
+    branchTime (0),
+    branchParam ("error-rate"),
+    sender ("bulk"),
+    senderRate ("0bps"),
+    bgModel ("packet"),
+    bgFluidInterval (0.01),
+    scheduler ("map"),
+    flows (1),
+    queueEndpoint ("droptail"),
+    queueProvider ("droptail"),
+    queueBackbone ("droptail"),
+    tcp ("scalable"),
+    nscLibrary ("liblinux2.6.26.so"),
+    // same algorithm as ns3::TcpScalable, cubic is the default of Linux 2.6.26
+    nscCongestion ("scalable"),
+    wireStats (false),
+    wireInterval (0.1),
+    tcpStats (false),
+    rank (0),
+    ranks (1)
+{
+}
+
+void
+ScenarioConfig::AddValues (CommandLine &cmd)
+{
+  // Here, we define additional command line options.
+  // This allows a user to override the defaults set above from the command line.
+  cmd.AddValue ("error-rate", "Error rate to apply to link", errRate);
+  cmd.AddValue ("error-model", "Error model of the link: none, rate (RateErrorModel), geometric or gilbert "
+                "(GeometricErrorModel, see its attributes for the bad state) (default none)", errorModel);
+  cmd.AddValue ("errorDevice", "Device with the error model, as <node id>:<device index> "
+                "(default: the receiver's star hub, on its access link)", errorDevice);
+  cmd.AddValue ("runtime", "How long the applications should send data (default 120 seconds)", runtime);
+  cmd.AddValue ("bgRate", "Background traffic rate (default 10kbps)", backgroundRate);
+  cmd.AddValue ("summary", "File receiving the per-run summary (default summary.csv)", summaryFile);
+  cmd.AddValue ("socketType", "TCP socket TypeId: ns3::TcpScalable, ns3::TcpScalableAggressive, "
+                "ns3::TcpRenoFast or ns3::TcpHighSpeed (default ns3::TcpScalable)", socketType);
+  cmd.AddValue ("pcap", "Packet capture: full, headers (see ns3::BoundedPcapCapture attributes) "
+                "or none (default full)", pcapMode);
+  cmd.AddValue ("flowStatsInterval", "Export FlowMonitor deltas to flow-stats.csv every this many "
+                "seconds instead of writing results.xml (default 0: disabled)", flowStatsInterval);
+  cmd.AddValue ("flowStatsBucket", "Delay histogram bucket width of the export, in seconds "
+                "(default 0.01)", flowStatsBucket);
+  cmd.AddValue ("converge", "Stop the run once goodput and cwnd are stable (default false)", converge);
+  cmd.AddValue ("ciTarget", "Relative half-width of the 95% confidence intervals needed to stop "
+                "(default 0.05)", ciTarget);
+  cmd.AddValue ("batchInterval", "Length of the batches of the convergence test, in seconds "
+                "(default 5)", batchInterval);
+  cmd.AddValue ("minTime", "Warm-up time not used by the convergence test, in seconds "
+                "(default 20)", minTime);
+  cmd.AddValue ("minBatches", "Batches needed before the convergence test can stop the run "
+                "(default 10)", minBatches);
+  cmd.AddValue ("ringSize", "Number of backbone nodes in the ring (default 4)", ringSize);
+  cmd.AddValue ("stars", "Number of star networks (default 2)", stars);
+  cmd.AddValue ("spokes", "Number of spokes of each star (default 3)", spokes);
+  cmd.AddValue ("routing", "Routing: global (tables computed on every node before the run) "
+                "or nix (nix-vectors computed on demand, for large topologies) (default global)", routing);
+  cmd.AddValue ("branchTime", "Simulate up to this time, then fork one process per branch value "
+                "(default 0: no branches)", branchTime);
+  cmd.AddValue ("branchParam", "Parameter set by the branches: error-rate or bgRate "
+                "(default error-rate)", branchParam);
+  cmd.AddValue ("branchValues", "Comma separated values of the branch parameter", branchValues);
+  cmd.AddValue ("sender", "Application of the bulk flow: bulk (BulkSendApplication) or batch "
+                "(MyApp, filling the send buffer in batches) (default bulk)", sender);
+  cmd.AddValue ("senderRate", "Rate limit of the batch sender (default 0bps: none)", senderRate);
+  cmd.AddValue ("bench", "Write the simulated events per second and the peak memory of the process "
+                "to this file name, next to the other outputs, see bench-compare.sh", benchFile);
+  cmd.AddValue ("profile", "Write the wall-clock time spent in each kind of event to this file name, "
+                "and the number of pending events to event-queue-depth.csv", profileFile);
+  cmd.AddValue ("scheduler", "Event scheduler: map, list, heap, calendar or dheap (4-ary heap "
+                "in one array, see ns3::DaryHeapScheduler) (default map)", scheduler);
+  cmd.AddValue ("flows", "Number of parallel bulk flows from the sender to the receiver (default 1)", flows);
+  cmd.AddValue ("bgModel", "Background traffic: packet (TCP OnOff flow) or fluid (capacity and queue "
+                "taken from the devices on its path) (default packet)", bgModel);
+  cmd.AddValue ("bgFluidInterval", "Update period of the fluid background, in seconds (default 0.01)",
+                bgFluidInterval);
+  cmd.AddValue ("queueEndpoint", "Queue of the star spoke links: droptail, fifo (drop-tail with "
+                "statistics), codel or fqcodel, see ns3::FqCoDelQueue (default droptail)", queueEndpoint);
+  cmd.AddValue ("queueProvider", "Queue of the links from the star hubs and clouds to the ring "
+                "(default droptail)", queueProvider);
+  cmd.AddValue ("queueBackbone", "Queue of the ring links (default droptail)", queueBackbone);
+  cmd.AddValue ("scenario", "Build the topology, applications and traces of this scenario file "
+                "instead of the built-in ones, see scenarios/", scenarioFile);
+  cmd.AddValue ("tcp", "TCP of the nodes: scalable (--socketType), nsc (the Linux stack of "
+                "--nscLibrary) or both, one run with each written side by side to tcp-compare.csv "
+                "(default scalable)", tcp);
+  cmd.AddValue ("nscLibrary", "NSC stack of --tcp=nsc (default liblinux2.6.26.so)", nscLibrary);
+  cmd.AddValue ("nscCongestion", "Congestion control of the NSC bulk senders (default scalable)", nscCongestion);
+  cmd.AddValue ("wireStats", "Write the flight size of the bulk senders, measured on their IP layer, "
+                "to flight.csv and count their retransmissions (default false)", wireStats);
+  cmd.AddValue ("wireInterval", "Sampling period of flight.csv, in seconds (default 0.1)", wireInterval);
+  cmd.AddValue ("tcpStats", "Write the running statistics of every TcpScalable flow (or other "
+                "--socketType variant) to tcp-stats.csv when it closes (default false)", tcpStats);
+}
+
+void
+ScenarioConfig::Check (void) const
+{
+  NS_ABORT_MSG_UNLESS (runtime > 3, "--runtime has to be more than 3 seconds, the bulk senders "
+                       "run from 1 s to runtime - 2 s");
+  // the output prefix of the run is put in front of these names
+  NS_ABORT_MSG_IF (benchFile.find ('/') != std::string::npos, "--bench takes a file name, without directory");
+  NS_ABORT_MSG_IF (profileFile.find ('/') != std::string::npos, "--profile takes a file name, without directory");
+}
+
+double
+ScenarioConfig::GetSendTime (void) const
+{
+  return runtime - 3.0;
+}
+
+/**
+ * Set the queue of the devices a helper installs: droptail keeps the
+ * DropTailQueue of PointToPointNetDevice, the others are FqCoDelQueue
+ * variants, whose sojourn times end up in queue-stats.csv.
+ */
+static void
+SetLinkQueue (PointToPointHelper &helper, const std::string &queue)
+{
+  if (queue == "fifo")
+    {
+      helper.SetQueue ("ns3::FqCoDelQueue", "Flows", UintegerValue (1), "CoDel", BooleanValue (false));
+    }
+  else if (queue == "codel")
+    {
+      helper.SetQueue ("ns3::FqCoDelQueue", "Flows", UintegerValue (1));
+    }
+  else if (queue == "fqcodel")
+    {
+      helper.SetQueue ("ns3::FqCoDelQueue");
+    }
+  else
+    {
+      NS_ABORT_MSG_UNLESS (queue == "droptail", "Unknown queue " << queue);
+    }
+}
+
+/**
+ * Write the sojourn times, drops and fairness of every FqCoDelQueue of
+ * the nodes this process simulates, one line per device.
+ */
+static void
+WriteQueueStats (const std::string &fileName, uint32_t rank)
+{
+  std::ofstream out (fileName.c_str ());
+  out << "node,device,peer,dequeued,codelDrops,overflowDrops,meanSojournMs,p50SojournMs,"
+      << "p95SojournMs,p99SojournMs,maxSojournMs,activeFlows,fairness" << std::endl;
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+    {
+      if ((*node)->GetSystemId () != rank)
+        {
+          continue;
+        }
+      for (uint32_t i = 0; i < (*node)->GetNDevices (); i++)
+        {
+          Ptr<PointToPointNetDevice> device = DynamicCast<PointToPointNetDevice> ((*node)->GetDevice (i));
+          if (device == 0)
+            {
+              continue;
+            }
+          Ptr<FqCoDelQueue> queue = DynamicCast<FqCoDelQueue> (device->GetQueue ());
+          if (queue == 0)
+            {
+              continue;
+            }
+          Ptr<Channel> channel = device->GetChannel ();
+          Ptr<NetDevice> peer = channel->GetDevice (0) == device ? channel->GetDevice (1) : channel->GetDevice (0);
+          out << (*node)->GetId () << "," << i << "," << peer->GetNode ()->GetId () << ","
+              << queue->GetDequeuedPackets () << "," << queue->GetCoDelDrops () << ","
+              << queue->GetOverflowDrops () << "," << queue->GetMeanSojourn ().GetSeconds () * 1000 << ","
+              << queue->GetSojournQuantile (0.5).GetSeconds () * 1000 << ","
+              << queue->GetSojournQuantile (0.95).GetSeconds () * 1000 << ","
+              << queue->GetSojournQuantile (0.99).GetSeconds () * 1000 << ","
+              << queue->GetMaxSojourn ().GetSeconds () * 1000 << ","
+              << queue->GetActiveFlows () << "," << queue->GetFairness () << std::endl;
+        }
+    }
+}
+
+/**
+ * Factory of the event scheduler of a scenario, wrapped in an
+ * InstrumentedScheduler when the run is benchmarked or profiled.
+ */
+static ObjectFactory
+CreateSchedulerFactory (const ScenarioConfig &config)
+{
+  std::map<std::string, std::string> types;
+  types["map"] = "ns3::MapScheduler";
+  types["list"] = "ns3::ListScheduler";
+  types["heap"] = "ns3::HeapScheduler";
+  types["calendar"] = "ns3::CalendarScheduler";
+  types["dheap"] = "ns3::DaryHeapScheduler";
+  NS_ABORT_MSG_IF (types.find (config.scheduler) == types.end (), "Unknown scheduler " << config.scheduler);
+
+  ObjectFactory scheduler;
+  scheduler.SetTypeId (types[config.scheduler]);
+  if (config.benchFile.empty () && config.profileFile.empty ())
+    {
+      return scheduler;
+    }
+  ObjectFactory instrumented;
+  instrumented.SetTypeId ("ns3::InstrumentedScheduler");
+  instrumented.Set ("Scheduler", ObjectFactoryValue (scheduler));
+  instrumented.Set ("Profile", BooleanValue (!config.profileFile.empty ()));
+  return instrumented;
+}
+
+/**
+ * Simulator::Run, and the end of the event profile of the run, if any, so
+ * that what follows is not charged to its last event.
+ */
+static void
+RunSimulation (void)
+{
+  Simulator::Run ();
+  InstrumentedScheduler *scheduler = InstrumentedScheduler::GetCurrent ();
+  if (scheduler != 0)
+    {
+      scheduler->StopProfile ();
+    }
+}
+
+/**
+ * Write summary.csv of the run that just ended, with the bench and profile
+ * reports it asked for. bgRate and errorRate are left empty when the run
+ * has none.
+ */
+static void
+WriteRunSummary (const ScenarioConfig &config, const std::string &prefix,
+                 const std::string &bgRate, const std::string &errorRate,
+                 const ApplicationContainer &senders, uint64_t rxBytes, uint64_t bgRxBytes,
+                 double sendTime, const std::string &stopReason, double runWall)
+{
+  // retransmissions of the bulk flows, and how many of them the receiver already had
+  uint64_t retransmitted = SumSenderAttribute (senders, "RetransmittedSegments");
+  uint64_t redundant = SumSenderAttribute (senders, "RedundantSegments");
+  std::ofstream summary ((prefix + config.summaryFile).c_str ());
+  summary << "runtime,bgRate,errorRate,rngRun,rxBytes,goodputKbps,bgRxBytes,stopTime,stopReason,"
+          << "retransmitted,redundant" << std::endl;
+  summary << config.runtime << "," << bgRate << "," << errorRate << "," << RngSeedManager::GetRun () << ","
+          << rxBytes << "," << rxBytes * 8.0 / 1000 / sendTime << "," << bgRxBytes << ","
+          << Simulator::Now ().GetSeconds () << "," << stopReason << ","
+          << retransmitted << "," << redundant << std::endl;
+  NS_LOG_UNCOND ("Received " << rxBytes << " bytes, background " << bgRxBytes << " bytes, "
+                 << retransmitted << " segments retransmitted, " << redundant << " of them redundant");
+  if (!config.benchFile.empty ())
+    {
+      WriteBenchReport (prefix + config.benchFile, runWall, rxBytes);
+    }
+  if (!config.profileFile.empty ())
+    {
+      WriteProfileReport (config.profileFile, prefix);
+    }
+}
+
+/**
+ * Results of the run that just ended, before Simulator::Destroy.
+ */
+static ScenarioResult
+MakeResult (uint64_t rxBytes, double sendTime, double runWall, const TcpWireMonitor *wire)
+{
+  ScenarioResult result;
+  result.rxBytes = rxBytes;
+  result.goodputKbps = rxBytes * 8.0 / 1000 / sendTime;
+  if (wire != 0)
+    {
+      result.retransmittedSegments = wire->GetRetransmittedSegments ();
+      result.retransmittedBytes = wire->GetRetransmittedBytes ();
+      NS_LOG_UNCOND ("On the wire: " << result.retransmittedSegments << " segments, "
+                     << result.retransmittedBytes << " bytes retransmitted");
+    }
+  InstrumentedScheduler *scheduler = InstrumentedScheduler::GetCurrent ();
+  result.events = scheduler != 0 ? scheduler->GetExecuteCount () : 0;
+  result.wallSeconds = runWall;
+  result.simSeconds = Simulator::Now ().GetSeconds ();
+  return result;
+}
+
+/**
+ * Routing and TCP of the Internet stack of a scenario. Nix-vector routing
+ * only computes the routes of the destinations in use, when they are first
+ * needed, instead of a full table on every node.
+ */
+static void
+ConfigureStack (InternetStackHelper &internet, const ScenarioConfig &config)
+{
+  if (config.tcp == "nsc")
+    {
+      internet.SetTcp ("ns3::NscTcpL4Protocol", "Library", StringValue (config.nscLibrary));
+    }
+  else
+    {
+      NS_ABORT_MSG_UNLESS (config.tcp == "scalable", "Unknown TCP " << config.tcp);
+    }
+
+  const std::string &routing = config.routing;
+  if (routing == "nix")
+    {
+      Ipv4StaticRoutingHelper staticRouting;
+      Ipv4NixVectorHelper nixRouting;
+      Ipv4ListRoutingHelper listRouting;
+      listRouting.Add (staticRouting, 0);
+      listRouting.Add (nixRouting, 10);
+      internet.SetRoutingHelper (listRouting);
+    }
+  else
+    {
+      NS_ABORT_MSG_UNLESS (routing == "global", "Unknown routing " << routing);
+    }
+}
+
+/**
+ * Congestion control of the Linux stack of a bulk sender under --tcp=nsc,
+ * a sysctl of the NSC stack object of its node. Only this node's path is
+ * matched.
+ */
+static void
+SetNscCongestion (Ptr<Node> node, const ScenarioConfig &config)
+{
+  if (config.tcp != "nsc")
+    {
+      return;
+    }
+  // the stack object is named after the library, e.g. ns3::Ns3NscStack<linux2.6.26>
+  const std::string &library = config.nscLibrary;
+  NS_ABORT_MSG_UNLESS (library.size () > 6 && library.compare (0, 3, "lib") == 0
+                       && library.compare (library.size () - 3, 3, ".so") == 0,
+                       "NSC library " << library << " is not named lib<stack>.so");
+  std::string stack = library.substr (3, library.size () - 6);
+  Config::Set ("/NodeList/" + SSTR (node->GetId ()) + "/$ns3::Ns3NscStack<" + stack
+               + ">/net.ipv4.tcp_congestion_control", StringValue (config.nscCongestion));
+}
+
+/**
+ * Topology, applications and traces read from a scenario file instead of
+ * the built-in topology, so that a new scenario needs no recompile.
+ *
+ * Each line holds one directive, "#" starts a comment:
+ *
+ *   default <TypeId>::<attribute> <value>
+ *   address <network>
+ *   node <name> [count=<n>]
+ *   ring <name> size=<n> <link options>
+ *   star <name> spokes=<n> <link options>
+ *   link <node> <node> <link options>
+ *   socket <node>|* <TypeId>
+ *   app bulk <from> <to> [port=8080] [flows=1] [start=1] [stop=<runtime - 2>]
+ *   app onoff <from> <to> rate=<rate> [size=512] [port=8080] [start=0] [stop=<runtime>]
+ *   error <node> <peer> <model> <rate>
+ *   trace pcap <node> <peer>
+ *   trace headers <node> <peer> [start=<StartTime>] [stop=<StopTime>]
+ *   trace flows
+ *
+ * with link options rate=<rate> delay=<time> [mtu=<bytes>]
+ * [queue=droptail|fifo|codel|fqcodel] [device:<attribute>=<value>]
+ * [channel:<attribute>=<value>]. See README.md for their meaning.
+ *
+ * Objects are created directly on the named nodes and get their attributes
+ * from the helpers of their link or application, so loading takes one pass
+ * over the file and no configuration path is ever matched.
+ */
+class ScenarioFile
+{
+public:
+  /**
+   * \param config options of the run: runtime, socket type and routing
+   * \param prefix prefix of the trace files
+   */
+  ScenarioFile (const ScenarioConfig &config, const std::string &prefix);
+  /// Restores the attribute defaults changed by the default directives
+  ~ScenarioFile ();
+
+  /**
+   * Build the scenario of a file.
+   */
+  void Load (const std::string &fileName);
+
+  /// Senders of the bulk flows
+  const ApplicationContainer & GetBulkSenders (void) const;
+  /// Sinks of the bulk flows
+  const ApplicationContainer & GetBulkSinks (void) const;
+  /// Sinks of the on/off background flows
+  const ApplicationContainer & GetBackgroundSinks (void) const;
+  /// Nodes running an application, monitored by the FlowMonitor
+  const NodeContainer & GetEndpoints (void) const;
+  /// Nodes running a bulk sender
+  const NodeContainer & GetBulkSenderNodes (void) const;
+
+private:
+  typedef std::map<std::string, std::string> Options;
+  /// ids of a node and of its peer on a link
+  typedef std::pair<uint32_t, uint32_t> NodePair;
+  /// id of a node and a port
+  typedef std::pair<uint32_t, uint16_t> NodePort;
+
+  /// "<file>:<line>: ", to start error messages
+  std::string Where (void) const;
+  /// Value of an option, removed from the options, or defaultValue
+  static std::string Take (Options &options, const std::string &key, const std::string &defaultValue);
+  /// Abort if an option was not used
+  void CheckUsed (const Options &options) const;
+
+  /// \name Directives of the file
+  //\{
+  void SetDefaultValue (const std::vector<std::string> &args);
+  void SetAddressBase (const std::vector<std::string> &args);
+  void CreateNodes (const std::vector<std::string> &args, Options &options);
+  void CreateRing (const std::vector<std::string> &args, Options &options);
+  void CreateStar (const std::vector<std::string> &args, Options &options);
+  void CreateLink (const std::vector<std::string> &args, Options &options);
+  void SetSocketType (const std::vector<std::string> &args);
+  void CreateApp (const std::vector<std::string> &args, Options &options);
+  void SetErrorModel (const std::vector<std::string> &args);
+  void EnableTrace (const std::vector<std::string> &args, Options &options);
+  //\}
+
+  /// Create a node with the Internet stack
+  Ptr<Node> CreateNode (const std::string &name);
+  /// Node of a name
+  Ptr<Node> GetNode (const std::string &name) const;
+  /// Device of node on its link to peer
+  Ptr<PointToPointNetDevice> GetDevice (const std::string &node, const std::string &peer) const;
+  /// Helper creating the links of some link options, shared by the links with the same options
+  PointToPointHelper & GetLinkHelper (Options &options);
+  /// Link two nodes with a new /30
+  void Connect (Ptr<Node> a, Ptr<Node> b, PointToPointHelper &helper);
+  /// Give an address of a /30 to a device, as Ipv4AddressHelper::Assign
+  static void AddAddress (Ptr<NetDevice> device, Ipv4Address address);
+  /// Monitor a node with the FlowMonitor
+  void AddEndpoint (Ptr<Node> node);
+  /// Sink of a node and port, installed on first use
+  Ptr<PacketSink> GetSink (Ptr<Node> node, uint16_t port, ApplicationContainer &kind);
+
+  const ScenarioConfig                           &m_config;
+  std::string                                     m_prefix;
+  std::string                                     m_fileName;
+  uint32_t                                        m_line;
+  InternetStackHelper                             m_internet;
+  uint32_t                                        m_network;
+  std::map<std::string, Ptr<Node> >               m_nodes;
+  std::map<NodePair, Ptr<PointToPointNetDevice> > m_devices;
+  std::map<std::string, PointToPointHelper>       m_linkHelpers;
+  std::map<NodePort, Ptr<PacketSink> >            m_sinks;
+  std::string                                     m_socketType;
+  std::map<uint32_t, std::string>                 m_nodeSocketTypes;
+  ApplicationContainer                            m_bulkSenders;
+  ApplicationContainer                            m_bulkSinks;
+  ApplicationContainer                            m_backgroundSinks;
+  ApplicationContainer                            m_tcpSenders;
+  std::vector<std::pair<std::string, std::string> > m_savedDefaults;
+  NodeContainer                                   m_endpoints;
+  NodeContainer                                   m_bulkSenderNodes;
+  std::set<uint32_t>                              m_endpointIds;
+  bool                                            m_traceFlows;
+  std::vector<Ptr<BoundedPcapCapture> >           m_captures;
+};
+
+ScenarioFile::ScenarioFile (const ScenarioConfig &config, const std::string &prefix)
+  : m_config (config),
+    m_prefix (prefix),
+    m_line (0),
+    m_network (Ipv4Address ("10.0.0.0").Get ()),
+    m_socketType (config.socketType),
+    m_traceFlows (false)
+{
+  ConfigureStack (m_internet, config);
+}
+
+ScenarioFile::~ScenarioFile ()
+{
+  // in reverse order, for the attributes set more than once
+  for (size_t i = m_savedDefaults.size (); i-- > 0; )
+    {
+      Config::SetDefault (m_savedDefaults[i].first, StringValue (m_savedDefaults[i].second));
+    }
+}
+
+const ApplicationContainer &
+ScenarioFile::GetBulkSenders (void) const
+{
+  return m_bulkSenders;
+}
+
+const ApplicationContainer &
+ScenarioFile::GetBulkSinks (void) const
+{
+  return m_bulkSinks;
+}
+
+const ApplicationContainer &
+ScenarioFile::GetBackgroundSinks (void) const
+{
+  return m_backgroundSinks;
+}
+
+const NodeContainer &
+ScenarioFile::GetEndpoints (void) const
+{
+  return m_endpoints;
+}
+
+const NodeContainer &
+ScenarioFile::GetBulkSenderNodes (void) const
+{
+  return m_bulkSenderNodes;
+}
+
+std::string
+ScenarioFile::Where (void) const
+{
+  return m_fileName + ":" + SSTR (m_line) + ": ";
+}
+
+std::string
+ScenarioFile::Take (Options &options, const std::string &key, const std::string &defaultValue)
+{
+  Options::iterator i = options.find (key);
+  if (i == options.end ())
+    {
+      return defaultValue;
+    }
+  std::string value = i->second;
+  options.erase (i);
+  return value;
+}
+
+void
+ScenarioFile::CheckUsed (const Options &options) const
+{
+  NS_ABORT_MSG_UNLESS (options.empty (), Where () << "unknown option " << options.begin ()->first);
+}
+
+void
+ScenarioFile::Load (const std::string &fileName)
+{
+  std::ifstream file (fileName.c_str ());
+  NS_ABORT_MSG_UNLESS (file, "Cannot open scenario file " << fileName);
+  m_fileName = fileName;
+  m_line = 0;
+  NS_LOG_UNCOND ("> Load scenario " << fileName);
+
+  std::string line;
+  while (std::getline (file, line))
+    {
+      m_line++;
+      std::string::size_type comment = line.find ('#');
+      if (comment != std::string::npos)
+        {
+          line.erase (comment);
+        }
+      // positional arguments, then key=value options
+      std::istringstream tokens (line);
+      std::vector<std::string> args;
+      Options options;
+      for (std::string token; tokens >> token; )
+        {
+          std::string::size_type equal = token.find ('=');
+          if (equal == std::string::npos)
+            {
+              NS_ABORT_MSG_UNLESS (options.empty (), Where () << "argument " << token << " after the options");
+              args.push_back (token);
+            }
+          else
+            {
+              options[token.substr (0, equal)] = token.substr (equal + 1);
+            }
+        }
+      if (args.empty ())
+        {
+          NS_ABORT_MSG_UNLESS (options.empty (), Where () << "options without a directive");
+          continue;
+        }
+
+      const std::string directive = args[0];
+      args.erase (args.begin ());
+      if (directive == "default")
+        {
+          SetDefaultValue (args);
+        }
+      else if (directive == "address")
+        {
+          SetAddressBase (args);
+        }
+      else if (directive == "node")
+        {
+          CreateNodes (args, options);
+        }
+      else if (directive == "ring")
+        {
+          CreateRing (args, options);
+        }
+      else if (directive == "star")
+        {
+          CreateStar (args, options);
+        }
+      else if (directive == "link")
+        {
+          CreateLink (args, options);
+        }
+      else if (directive == "socket")
+        {
+          SetSocketType (args);
+        }
+      else if (directive == "app")
+        {
+          CreateApp (args, options);
+        }
+      else if (directive == "error")
+        {
+          SetErrorModel (args);
+        }
+      else if (directive == "trace")
+        {
+          EnableTrace (args, options);
+        }
+      else
+        {
+          NS_FATAL_ERROR (Where () << "unknown directive " << directive);
+        }
+      CheckUsed (options);
+    }
+
+  // The socket type is an attribute of the TCP of each node, set here
+  // once the nodes are known.
+  for (std::map<std::string, Ptr<Node> >::const_iterator i = m_nodes.begin (); i != m_nodes.end (); ++i)
+    {
+      std::map<uint32_t, std::string>::const_iterator type = m_nodeSocketTypes.find (i->second->GetId ());
+      std::string name = type == m_nodeSocketTypes.end () ? m_socketType : type->second;
+      Ptr<TcpL4Protocol> tcp = i->second->GetObject<TcpL4Protocol> ();
+      if (tcp == 0)
+        {
+          // NSC, whose sockets are always the Linux ones
+          continue;
+        }
+      tcp->SetAttribute ("SocketType", TypeIdValue (TypeId::LookupByName (name)));
+    }
+  // Set on the sockets of this scenario only, so that the next scenario
+  // of a batch does not write over these files.
+  if (m_traceFlows)
+    {
+      SetSenderSocketAttribute (m_tcpSenders, "TracePrefix", m_prefix + "flow-");
+    }
+  if (m_config.tcpStats)
+    {
+      SetSenderSocketAttribute (m_tcpSenders, "StatsFile", m_prefix + "tcp-stats.csv");
+    }
+  NS_LOG_UNCOND (">> " << m_nodes.size () << " nodes, " << m_devices.size () / 2 << " links, "
+                 << m_bulkSenders.GetN () << " bulk flows");
+}
+
+void
+ScenarioFile::SetDefaultValue (const std::vector<std::string> &args)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 2, Where () << "default <TypeId>::<attribute> <value>");
+  std::string previous = GetAttributeDefault (args[0]);
+  NS_ABORT_MSG_UNLESS (Config::SetDefaultFailSafe (args[0], StringValue (args[1])),
+                       Where () << "cannot set " << args[0] << " to " << args[1]);
+  m_savedDefaults.push_back (std::make_pair (args[0], previous));
+}
+
+void
+ScenarioFile::SetAddressBase (const std::vector<std::string> &args)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 1, Where () << "address <network>");
+  m_network = Ipv4Address (args[0].c_str ()).Get ();
+  NS_ABORT_MSG_IF (m_network & 3, Where () << args[0] << " is not the start of a /30");
+}
+
+Ptr<Node>
+ScenarioFile::CreateNode (const std::string &name)
+{
+  NS_ABORT_MSG_IF (m_nodes.find (name) != m_nodes.end (), Where () << "node " << name << " already exists");
+  Ptr<Node> node = CreateObject<Node> ();
+  m_internet.Install (node);
+  m_nodes[name] = node;
+  return node;
+}
+
+Ptr<Node>
+ScenarioFile::GetNode (const std::string &name) const
+{
+  std::map<std::string, Ptr<Node> >::const_iterator i = m_nodes.find (name);
+  NS_ABORT_MSG_IF (i == m_nodes.end (), Where () << "no node " << name);
+  return i->second;
+}
+
+Ptr<PointToPointNetDevice>
+ScenarioFile::GetDevice (const std::string &node, const std::string &peer) const
+{
+  std::map<NodePair, Ptr<PointToPointNetDevice> >::const_iterator i =
+    m_devices.find (NodePair (GetNode (node)->GetId (), GetNode (peer)->GetId ()));
+  NS_ABORT_MSG_IF (i == m_devices.end (), Where () << "no link between " << node << " and " << peer);
+  return i->second;
+}
+
+void
+ScenarioFile::CreateNodes (const std::vector<std::string> &args, Options &options)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 1, Where () << "node <name> [count=<n>]");
+  std::string count = Take (options, "count", "");
+  if (count.empty ())
+    {
+      CreateNode (args[0]);
+      return;
+    }
+  for (int i = 0; i < std::atoi (count.c_str ()); i++)
+    {
+      CreateNode (args[0] + "." + SSTR (i));
+    }
 }
 
-/**
- * Default deconstructor.
- */
-MyApp::~MyApp()
+PointToPointHelper &
+ScenarioFile::GetLinkHelper (Options &options)
 {
-  m_socket = 0;
+  // The remaining options all describe the link.
+  std::string key;
+  for (Options::const_iterator i = options.begin (); i != options.end (); ++i)
+    {
+      key += i->first + "=" + i->second + " ";
+    }
+  std::map<std::string, PointToPointHelper>::iterator i = m_linkHelpers.find (key);
+  if (i != m_linkHelpers.end ())
+    {
+      options.clear ();
+      return i->second;
+    }
+
+  PointToPointHelper &helper = m_linkHelpers[key];
+  std::string rate = Take (options, "rate", "");
+  std::string delay = Take (options, "delay", "");
+  NS_ABORT_MSG_IF (rate.empty () || delay.empty (), Where () << "links need rate=<rate> and delay=<time>");
+  helper.SetDeviceAttribute ("DataRate", StringValue (rate));
+  helper.SetChannelAttribute ("Delay", StringValue (delay));
+  std::string mtu = Take (options, "mtu", "");
+  if (!mtu.empty ())
+    {
+      helper.SetDeviceAttribute ("Mtu", StringValue (mtu));
+    }
+  SetLinkQueue (helper, Take (options, "queue", "droptail"));
+  for (Options::iterator i = options.begin (); i != options.end (); )
+    {
+      if (i->first.compare (0, 7, "device:") == 0)
+        {
+          helper.SetDeviceAttribute (i->first.substr (7), StringValue (i->second));
+        }
+      else if (i->first.compare (0, 8, "channel:") == 0)
+        {
+          helper.SetChannelAttribute (i->first.substr (8), StringValue (i->second));
+        }
+      else
+        {
+          ++i;
+          continue;
+        }
+      options.erase (i++);
+    }
+  return helper;
 }
 
-/**
- * Setup the application.
- * Parameters:
- * socket     Socket to send data to.
- * address    Address to send data to.
- * packetSize Size of the packets to send.
- * nPackets   Number of packets to send.
- * dataRate   Data rate used to determine when to send the packets.
- */
 void
-MyApp::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate)
+ScenarioFile::Connect (Ptr<Node> a, Ptr<Node> b, PointToPointHelper &helper)
 {
-  m_socket = socket;
-  m_peer = address;
-  m_packetSize = packetSize;
-  m_nPackets = nPackets;
-  m_dataRate = dataRate;
+  NetDeviceContainer devices = helper.Install (a, b);
+  AddAddress (devices.Get (0), Ipv4Address (m_network + 1));
+  AddAddress (devices.Get (1), Ipv4Address (m_network + 2));
+  m_network += 4;
+  m_devices[NodePair (a->GetId (), b->GetId ())] = DynamicCast<PointToPointNetDevice> (devices.Get (0));
+  m_devices[NodePair (b->GetId (), a->GetId ())] = DynamicCast<PointToPointNetDevice> (devices.Get (1));
 }
 
-/**
- * Start sending data to the address given in the Setup method.
- */
 void
-MyApp::StartApplication (void)
+ScenarioFile::AddAddress (Ptr<NetDevice> device, Ipv4Address address)
 {
-  m_running = true;
-  m_packetsSent = 0;
-  m_socket->Bind ();
-  m_socket->Connect (m_peer);
-  SendPacket ();
+  Ptr<Ipv4> ipv4 = device->GetNode ()->GetObject<Ipv4> ();
+  int32_t interface = ipv4->GetInterfaceForDevice (device);
+  if (interface == -1)
+    {
+      interface = ipv4->AddInterface (device);
+    }
+  ipv4->AddAddress (interface, Ipv4InterfaceAddress (address, Ipv4Mask ("255.255.255.252")));
+  ipv4->SetMetric (interface, 1);
+  ipv4->SetUp (interface);
 }
 
-/**
- * Stop sending data to the address given in the Setup method.
- */
-void 
-MyApp::StopApplication (void)
+void
+ScenarioFile::CreateRing (const std::vector<std::string> &args, Options &options)
 {
-  m_running = false;
-
-  if (m_sendEvent.IsRunning ())
+  NS_ABORT_MSG_UNLESS (args.size () == 1, Where () << "ring <name> size=<n> <link options>");
+  int size = std::atoi (Take (options, "size", "0").c_str ());
+  NS_ABORT_MSG_IF (size < 2, Where () << "a ring needs size=<n> of at least 2");
+  PointToPointHelper &helper = GetLinkHelper (options);
+  std::vector<Ptr<Node> > nodes;
+  for (int i = 0; i < size; i++)
     {
-      Simulator::Cancel (m_sendEvent);
+      nodes.push_back (CreateNode (args[0] + "." + SSTR (i)));
     }
+  // a ring of two nodes is one link
+  for (int i = 0; i < (size == 2 ? 1 : size); i++)
+    {
+      Connect (nodes[i], nodes[(i + 1) % size], helper);
+    }
+}
 
-  if (m_socket)
+void
+ScenarioFile::CreateStar (const std::vector<std::string> &args, Options &options)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 1, Where () << "star <name> spokes=<n> <link options>");
+  int spokes = std::atoi (Take (options, "spokes", "0").c_str ());
+  NS_ABORT_MSG_IF (spokes < 1, Where () << "a star needs spokes=<n> of at least 1");
+  PointToPointHelper &helper = GetLinkHelper (options);
+  Ptr<Node> hub = CreateNode (args[0] + ".hub");
+  for (int i = 0; i < spokes; i++)
     {
-      m_socket->Close ();
+      Connect (hub, CreateNode (args[0] + "." + SSTR (i)), helper);
     }
 }
 
-/**
- * Send a packet to the receiver.
- */
-void 
-MyApp::SendPacket (void)
+void
+ScenarioFile::CreateLink (const std::vector<std::string> &args, Options &options)
 {
-  Ptr<Packet> packet = Create<Packet> (m_packetSize);
-  m_socket->Send (packet);
+  NS_ABORT_MSG_UNLESS (args.size () == 2, Where () << "link <node> <node> <link options>");
+  Connect (GetNode (args[0]), GetNode (args[1]), GetLinkHelper (options));
+}
 
-  if (++m_packetsSent < m_nPackets)
+void
+ScenarioFile::SetSocketType (const std::vector<std::string> &args)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 2, Where () << "socket <node>|* <TypeId>");
+  TypeId tid;
+  NS_ABORT_MSG_UNLESS (TypeId::LookupByNameFailSafe (args[1], &tid), Where () << "unknown TypeId " << args[1]);
+  if (args[0] == "*")
     {
-      ScheduleTx ();
+      m_socketType = args[1];
+      m_nodeSocketTypes.clear ();
     }
   else
     {
-      std::cout << "Done sending packets: " << m_packetsSent;
+      m_nodeSocketTypes[GetNode (args[0])->GetId ()] = args[1];
     }
-  NS_LOG_UNCOND ("Packet sent");
 }
 
-/**
- * Schedule when the next packet will be sent.
- */
-void 
-MyApp::ScheduleTx (void)
+void
+ScenarioFile::AddEndpoint (Ptr<Node> node)
 {
-  if (m_running)
+  if (m_endpointIds.insert (node->GetId ()).second)
     {
-      Time tNext (Seconds (m_packetSize * 8 / static_cast<double> (m_dataRate.GetBitRate ())));
-      NS_LOG_UNCOND("Send next packet at: " << tNext);
-      m_sendEvent = Simulator::Schedule (tNext, &MyApp::SendPacket, this);
+      m_endpoints.Add (node);
     }
 }
 
+Ptr<PacketSink>
+ScenarioFile::GetSink (Ptr<Node> node, uint16_t port, ApplicationContainer &kind)
+{
+  NodePort key (node->GetId (), port);
+  std::map<NodePort, Ptr<PacketSink> >::const_iterator i = m_sinks.find (key);
+  if (i != m_sinks.end ())
+    {
+      bool sameKind = false;
+      for (uint32_t j = 0; j < kind.GetN (); j++)
+        {
+          sameKind = sameKind || kind.Get (j) == i->second;
+        }
+      NS_ABORT_MSG_UNLESS (sameKind, Where () << "bulk and on/off flows need different ports");
+      return i->second;
+    }
 
+  PacketSinkHelper helper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+  ApplicationContainer sink = helper.Install (node);
+  sink.Start (Seconds (0));
+  sink.Stop (Seconds (m_config.runtime + 60.0));
+  kind.Add (sink);
+  AddEndpoint (node);
+  m_sinks[key] = DynamicCast<PacketSink> (sink.Get (0));
+  return m_sinks[key];
+}
 
+void
+ScenarioFile::CreateApp (const std::vector<std::string> &args, Options &options)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 3, Where () << "app bulk|onoff <from> <to> [options]");
+  Ptr<Node> from = GetNode (args[1]);
+  Ptr<Node> to = GetNode (args[2]);
+  NS_ABORT_MSG_IF (to->GetObject<Ipv4> ()->GetNInterfaces () < 2, Where () << args[2] << " has no link");
+  uint16_t port = std::atoi (Take (options, "port", "8080").c_str ());
+  // the first address of the destination, on its first link
+  Address remote (InetSocketAddress (to->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal (), port));
+  AddEndpoint (from);
+
+  if (args[0] == "bulk")
+    {
+      GetSink (to, port, m_bulkSinks);
+      int flows = std::atoi (Take (options, "flows", "1").c_str ());
+      double start = std::atof (Take (options, "start", "1").c_str ());
+      double stop = std::atof (Take (options, "stop", SSTR (m_config.runtime - 2.0)).c_str ());
+      if (std::find (m_bulkSenderNodes.Begin (), m_bulkSenderNodes.End (), from) == m_bulkSenderNodes.End ())
+        {
+          m_bulkSenderNodes.Add (from);
+          SetNscCongestion (from, m_config);
+        }
+      BulkSendHelper helper ("ns3::TcpSocketFactory", remote);
+      helper.SetAttribute ("MaxBytes", UintegerValue (0));
+      for (int flow = 0; flow < flows; flow++)
+        {
+          ApplicationContainer app = helper.Install (from);
+          app.Start (Seconds (start));
+          app.Stop (Seconds (stop));
+          m_bulkSenders.Add (app);
+          m_tcpSenders.Add (app);
+        }
+    }
+  else if (args[0] == "onoff")
+    {
+      GetSink (to, port, m_backgroundSinks);
+      std::string rate = Take (options, "rate", "");
+      NS_ABORT_MSG_IF (rate.empty (), Where () << "on/off flows need rate=<rate>");
+      OnOffHelper helper ("ns3::TcpSocketFactory", remote);
+      helper.SetConstantRate (DataRate (rate), std::atoi (Take (options, "size", "512").c_str ()));
+      ApplicationContainer app = helper.Install (from);
+      app.Start (Seconds (std::atof (Take (options, "start", "0").c_str ())));
+      app.Stop (Seconds (std::atof (Take (options, "stop", SSTR (m_config.runtime)).c_str ())));
+      m_tcpSenders.Add (app);
+    }
+  else
+    {
+      NS_FATAL_ERROR (Where () << "unknown application " << args[0]);
+    }
+}
 
+void
+ScenarioFile::SetErrorModel (const std::vector<std::string> &args)
+{
+  NS_ABORT_MSG_UNLESS (args.size () == 4, Where () << "error <node> <peer> <model> <rate>");
+  GetDevice (args[0], args[1])->SetReceiveErrorModel (CreateErrorModel (args[2], std::atof (args[3].c_str ())));
+}
 
+void
+ScenarioFile::EnableTrace (const std::vector<std::string> &args, Options &options)
+{
+  if (args.size () == 1 && args[0] == "flows")
+    {
+      m_traceFlows = true;
+      return;
+    }
+  NS_ABORT_MSG_UNLESS (args.size () == 3, Where () << "trace pcap|headers <node> <peer>, or trace flows");
+  Ptr<PointToPointNetDevice> device = GetDevice (args[1], args[2]);
+  std::string name = "scenario-" + args[1] + "-" + args[2];
+  if (args[0] == "pcap")
+    {
+      PointToPointHelper ().EnablePcap (m_prefix + name + ".pcap", device, false, true);
+    }
+  else
+    {
+      NS_ABORT_MSG_UNLESS (args[0] == "headers", Where () << "unknown trace " << args[0]);
+      // the window of this device, by default that of the attributes
+      Ptr<BoundedPcapCapture> capture = CreateObject<BoundedPcapCapture> ();
+      TimeValue start;
+      TimeValue stop;
+      capture->GetAttribute ("StartTime", start);
+      capture->GetAttribute ("StopTime", stop);
+      capture->Install (device, m_prefix + name,
+                        Seconds (std::atof (Take (options, "start", SSTR (start.Get ().GetSeconds ())).c_str ())),
+                        Seconds (std::atof (Take (options, "stop", SSTR (stop.Get ().GetSeconds ())).c_str ())));
+      m_captures.push_back (capture);
+    }
+}
 
+/**
+ * Run a scenario read from config.scenarioFile and write its summary, in
+ * the format of RunScenario. The foreground flows are the bulk ones, the
+ * background the on/off ones.
+ */
+static ScenarioResult
+RunScenarioFile (const ScenarioConfig &config, const std::string &prefix)
+{
+  NS_ABORT_MSG_IF (config.ranks > 1, "Scenario files cannot run distributed");
+  NS_ABORT_MSG_IF (config.branchTime > 0, "Scenario files cannot fork branches");
+  NS_ABORT_MSG_IF (config.converge, "The convergence test needs the built-in scenario");
+  Simulator::SetScheduler (CreateSchedulerFactory (config));
+
+  ScenarioFile scenario (config, prefix);
+  scenario.Load (config.scenarioFile);
+  if (config.routing == "global")
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
 
+  FlowMonitorHelper flowmon;
+  Ptr<FlowMonitor> monitor = flowmon.Install (scenario.GetEndpoints ());
+  std::auto_ptr<TcpWireMonitor> wire;
+  if (config.wireStats)
+    {
+      wire.reset (new TcpWireMonitor (Seconds (config.wireInterval), prefix + "flight.csv"));
+      for (uint32_t i = 0; i < scenario.GetBulkSenderNodes ().GetN (); i++)
+        {
+          wire->Install (scenario.GetBulkSenderNodes ().Get (i));
+        }
+    }
 
+  Simulator::Stop (Seconds (config.runtime + 60.0));
+  double runStart = WallSeconds ();
+  RunSimulation ();
+  double runWall = WallSeconds () - runStart;
+  monitor->SerializeToXmlFile (prefix + "results.xml", true, true);
 
+  uint64_t rxBytes = 0;
+  for (uint32_t i = 0; i < scenario.GetBulkSinks ().GetN (); i++)
+    {
+      rxBytes += DynamicCast<PacketSink> (scenario.GetBulkSinks ().Get (i))->GetTotalRx ();
+    }
+  uint64_t bgRxBytes = 0;
+  for (uint32_t i = 0; i < scenario.GetBackgroundSinks ().GetN (); i++)
+    {
+      bgRxBytes += DynamicCast<PacketSink> (scenario.GetBackgroundSinks ().Get (i))->GetTotalRx ();
+    }
+  double sendTime = config.GetSendTime ();
+  WriteRunSummary (config, prefix, "", "", scenario.GetBulkSenders (), rxBytes, bgRxBytes, sendTime, "end", runWall);
+  WriteQueueStats (prefix + "queue-stats.csv", config.rank);
+  BoundedPcapCapture::CompressAll ();
+  ScenarioResult result = MakeResult (rxBytes, sendTime, runWall, wire.get ());
+  Simulator::Destroy ();
+  return result;
+}
 
-
-
-
-
-
-int main (int argc, char *argv[])
+/**
+ * Build the topology of one scenario, run it and write its results.
+ * All the output files are prefixed with \p prefix.
+ */
+static ScenarioResult
+RunScenario (const ScenarioConfig &config, std::string prefix)
 {
-  NS_LOG_UNCOND ("> Parse configuration");
-  Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (512));
-  // Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("1Mbps"));
-  // Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (TcpScalable::GetTypeId()));
-  Config::SetDefault ("ns3::TcpSocket::SegmentSize",  UintegerValue(1000));
-
-  // cubic is the default congestion algorithm in Linux 2.6.26
-  std::string tcpCong = "scalable";
-  // this is the default error rate of our link, that is, the the probability of a single
-  // byte being 'corrupted' during transfer.
-  double errRate = 0.000001;
-  // how long the sender should be running, in seconds.
-  unsigned int runtime = 300;
+  double errRate = config.errRate;
+  const unsigned int runtime = config.runtime;
+  std::string backgroundRate = config.backgroundRate;
 
-  std::string backgroundRate = "10kbps";
-  CommandLine cmd;
-  // Here, we define additional command line options.
-  // This allows a user to override the defaults set above from the command line.
-  cmd.AddValue ("error-rate", "Error rate to apply to link", errRate);
-  cmd.AddValue ("runtime", "How long the applications should send data (default 120 seconds)", runtime);
-  cmd.AddValue ("bgRate", "Background traffic rate (default 10kbps)", backgroundRate);
-  cmd.Parse (argc, argv);
+  std::vector<std::string> branchValues;
+  if (config.branchTime > 0)
+    {
+      std::istringstream values (config.branchValues);
+      for (std::string value; std::getline (values, value, ','); )
+        {
+          branchValues.push_back (value);
+        }
+      NS_ABORT_MSG_IF (branchValues.empty (), "--branchTime needs --branchValues");
+      NS_ABORT_MSG_UNLESS (config.branchParam == "error-rate" || config.branchParam == "bgRate",
+                           "Unknown branch parameter " << config.branchParam);
+      // the pcap files of the helper cannot be reopened by the branches
+      NS_ABORT_MSG_IF (config.pcapMode == "full", "Branches need --pcap=headers or --pcap=none");
+      NS_ABORT_MSG_IF (config.wireStats, "Branches cannot share flight.csv, drop --wireStats");
+      NS_ABORT_MSG_IF (config.tcpStats || !GetAttributeDefault (config.socketType + "::StatsFile").empty (),
+                       "Branches cannot share a statistics file, drop --tcpStats and StatsFile");
+    }
+  if (!config.scenarioFile.empty ())
+    {
+      return RunScenarioFile (config, prefix);
+    }
+  NS_ABORT_MSG_IF (config.flows < 1, "--flows needs at least one flow");
+  Simulator::SetScheduler (CreateSchedulerFactory (config));
 
   NS_LOG_UNCOND ("> Create nodes");
   NodeContainer internetNodes;
 
-  const int internetNodesCount = 4;
+  const uint32_t internetNodesCount = config.ringSize;
+  const uint32_t starCount = config.stars;
+  const uint32_t nodesInStar = config.spokes;
+  NS_ABORT_MSG_IF (internetNodesCount < 2, "The ring needs at least 2 nodes");
+  NS_ABORT_MSG_IF (starCount < 2, "The bulk flow needs at least 2 stars");
+  NS_ABORT_MSG_IF (nodesInStar < 1, "A star needs at least one spoke");
   NS_LOG_UNCOND (">> Internet nodes in ring: " << internetNodesCount);
-  internetNodes.Create (internetNodesCount);
+  // Contiguous arcs of the ring go to each rank, so that only two backbone
+  // links per rank (2 ms of lookahead) cross ranks; stars and clouds live
+  // on the rank of their ring node.
+  std::vector<uint32_t> ringRank (internetNodesCount);
+  for (uint32_t i=0; i<internetNodesCount; i++) {
+    ringRank[i] = uint64_t (i) * config.ranks / internetNodesCount;
+    internetNodes.Create (1, ringRank[i]);
+  }
 
   PointToPointHelper p2pBackbone;
   p2pBackbone.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
   p2pBackbone.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
+  SetLinkQueue (p2pBackbone, config.queueBackbone);
 
   InternetStackHelper internet;
+  ConfigureStack (internet, config);
   internet.Install (internetNodes);
-  Ipv4InterfaceContainer ipv4InterfacesInternet[4];
+  std::vector<Ipv4InterfaceContainer> ipv4InterfacesInternet (internetNodesCount);
 
-  for (int i=0; i<internetNodesCount; i++) {
-    int j = i + 1;
+  // Every link gets its own /30: backbone links in 10.0.0.0/8, access links
+  // of the star hubs and clouds in 11.0.0.0/8, star spokes in 12.0.0.0/8.
+  Ipv4AddressHelper ipv4Backbone ("10.0.0.0", "255.255.255.252");
+  Ipv4AddressHelper ipv4Provider ("11.0.0.0", "255.255.255.252");
+
+  for (uint32_t i=0; i<internetNodesCount; i++) {
+    uint32_t j = i + 1;
     if (j >= internetNodesCount) j = 0;
     NodeContainer twoNodes = NodeContainer (internetNodes.Get (i), internetNodes.Get (j));
 
@@ -255,10 +2595,8 @@ int main (int argc, char *argv[])
     p2pInterfaces.Get (0)->SetMtu (1500);
     p2pInterfaces.Get (1)->SetMtu (1500);
 
-    Ipv4AddressHelper ipv4;
-    std::string baseIp = SSTR(i + 1) + std::string(".0.0.0");
-    ipv4.SetBase (baseIp.c_str(), "255.255.255.0");
-    ipv4InterfacesInternet[i] = ipv4.Assign (p2pInterfaces);
+    ipv4InterfacesInternet[i] = ipv4Backbone.Assign (p2pInterfaces);
+    ipv4Backbone.NewNetwork ();
     NS_LOG_UNCOND (">>> Connect " << i << " and " << j << ": " <<
                     ipv4InterfacesInternet[i].GetAddress(0) << "@" << internetNodes.Get (i)->GetId() << " => " << ipv4InterfacesInternet[i].GetAddress(1) << "@" << internetNodes.Get (j)->GetId());
   }
@@ -268,58 +2606,64 @@ int main (int argc, char *argv[])
   p2pInternetProvider.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("1Mbps")));
   // p2pInternetProvider.SetDeviceAttribute ("DataRate", DataRateValue (DataRate (6 * 1000 * 1000)));
   p2pInternetProvider.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
+  SetLinkQueue (p2pInternetProvider, config.queueProvider);
 
   PointToPointHelper p2pEndpoint;
   // create point-to-point link with a bandwidth of 6MBit/s and a large delay (0.5 seconds)
   // p2pEndpoint.SetDeviceAttribute ("DataRate", DataRateValue (DataRate (6 * 1000 * 1000)));
   p2pEndpoint.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("1Mbps")));
   p2pEndpoint.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (40)));
+  SetLinkQueue (p2pEndpoint, config.queueEndpoint);
 
-  const int nodesInStar = 3;
-  PointToPointStarHelper star1 = PointToPointStarHelper(nodesInStar, p2pEndpoint);
-  PointToPointStarHelper star2 = PointToPointStarHelper(nodesInStar, p2pEndpoint);
-  PointToPointStarHelper starNetworks[2] = {star1, star2};
+  std::vector<StarNetwork> starNetworks;
+  starNetworks.reserve (starCount);
+  for (uint32_t starId=0; starId<starCount; starId++) {
+    uint32_t i = 2 * (starId % ((internetNodesCount + 1) / 2));
+    starNetworks.push_back (StarNetwork (nodesInStar, p2pEndpoint, ringRank[i]));
+  }
 
-  Ipv4AddressHelper ipv4StarNetworks[2];
-  Ipv4InterfaceContainer ipv4InterfacesStarNetworks[2];
-  NetDeviceContainer starNetDeviceContainer[2];
+  std::vector<Ipv4InterfaceContainer> ipv4InterfacesStarNetworks (starCount);
+  std::vector<NetDeviceContainer> starNetDeviceContainer (starCount);
 
+  // Stars hang off the even ring nodes, round robin when there are more
+  // stars than even nodes.
   NS_LOG_UNCOND ("> Create networks");
-  for (int i=0, starId=0; i<internetNodesCount; i+=2, starId++) {
+  for (uint32_t starId=0; starId<starCount; starId++) {
+    uint32_t i = 2 * (starId % ((internetNodesCount + 1) / 2));
     starNetworks[starId].InstallStack (internet);
-    std::string baseIp = SSTR(i + 1) + std::string(".0.100.0");
-    starNetworks[starId].AssignIpv4Addresses (Ipv4AddressHelper (baseIp.c_str(), "255.255.255.0"));
+    Ipv4Address base (Ipv4Address ("12.0.0.0").Get () + starId * nodesInStar * 4);
+    starNetworks[starId].AssignIpv4Addresses (Ipv4AddressHelper (base, "255.255.255.252"));
 
-    NS_LOG_UNCOND (">> Star of " << nodesInStar << " nodes at " << baseIp << "/24");
+    NS_LOG_UNCOND (">> Star of " << nodesInStar << " nodes at " << base << " (one /30 per spoke)");
 
     NodeContainer twoNodes = NodeContainer (internetNodes.Get (i), starNetworks[starId].GetHub ());
     starNetDeviceContainer[starId] = p2pInternetProvider.Install(twoNodes);
-    baseIp = SSTR(i + 1) + std::string(".1.0.0");
-    ipv4StarNetworks[starId].SetBase (baseIp.c_str(), "255.255.255.0");
-    ipv4InterfacesStarNetworks[starId] = ipv4StarNetworks[starId].Assign (starNetDeviceContainer[starId]);
+    ipv4InterfacesStarNetworks[starId] = ipv4Provider.Assign (starNetDeviceContainer[starId]);
+    ipv4Provider.NewNetwork ();
     NS_LOG_UNCOND (">>> Connect star hub " << ipv4InterfacesStarNetworks[starId].GetAddress(1) << " @" << starNetworks[starId].GetHub ()->GetId() <<
                    " to internet node " << ipv4InterfacesStarNetworks[starId].GetAddress(0) << " @" << internetNodes.Get (i)->GetId());
   }
 
 
-  NodeContainer cloud1;
-  cloud1.Create (1);
-  NodeContainer cloud2;
-  cloud2.Create (1);
-  NodeContainer cloudNetworks[2] = {cloud1, cloud2};
-  Ipv4InterfaceContainer ipv4InterfacesCloud[2];
+  // one cloud on every odd ring node
+  const uint32_t cloudCount = internetNodesCount / 2;
+  NodeContainer cloudNodes;
+  for (uint32_t i=1; i<internetNodesCount; i+=2) {
+    cloudNodes.Create (1, ringRank[i]);
+  }
+  std::vector<NodeContainer> cloudNetworks;
+  std::vector<Ipv4InterfaceContainer> ipv4InterfacesCloud (cloudCount);
 
-  for (int i=1, cloudId=0; i<internetNodesCount; i+=2, cloudId++) {
+  for (uint32_t i=1, cloudId=0; i<internetNodesCount; i+=2, cloudId++) {
+    cloudNetworks.push_back (NodeContainer (cloudNodes.Get (cloudId)));
     internet.Install (cloudNetworks[cloudId]);
 
     NS_LOG_UNCOND (">> Cloud");
 
     NodeContainer twoNodes = NodeContainer (internetNodes.Get (i), cloudNetworks[cloudId].Get (0));
     NetDeviceContainer p2pInterfaces = p2pInternetProvider.Install(twoNodes);
-    Ipv4AddressHelper ipv4;
-    std::string baseIp = SSTR(i + 1) + std::string(".1.0.0");
-    ipv4.SetBase (baseIp.c_str(), "255.255.255.0");
-    ipv4InterfacesCloud[cloudId] = ipv4.Assign (p2pInterfaces);
+    ipv4InterfacesCloud[cloudId] = ipv4Provider.Assign (p2pInterfaces);
+    ipv4Provider.NewNetwork ();
     NS_LOG_UNCOND (">>> Connect cloud hub " << ipv4InterfacesCloud[cloudId].GetAddress(1)  << " @" << cloudNetworks[cloudId].Get (0)->GetId() <<
                    " to internet node " << ipv4InterfacesCloud[cloudId].GetAddress(0) << " @" << internetNodes.Get (i)->GetId());
   }
@@ -327,7 +2671,10 @@ int main (int argc, char *argv[])
   NS_LOG_UNCOND ("> Setup traffic");
   // p2pInterfaces.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em2));
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  if (config.routing == "global")
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
 
   uint16_t servPort = 8080;
   PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), servPort));
@@ -344,16 +2691,18 @@ int main (int argc, char *argv[])
 
   ns3::Ptr<ns3::Node> senderNode = starNetworks[0].GetSpokeNode(0);
   Ipv4Address senderAddr = starNetworks[0].GetSpokeIpv4Address(0);
+  SetNscCongestion (senderNode, config);
 
-
-  // DoubleValue rate (errRate);
-  // Ptr<RateErrorModel> em1 = 
-  //   CreateObjectWithAttributes<RateErrorModel> ("RanVar", StringValue ("ns3::UniformRandomVariable[Min=0.0,Max=1.0]"), "ErrorRate", rate);
-  // starNetDeviceContainer[1].Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em1));
+  Ptr<PointToPointNetDevice> errorDevice = FindErrorDevice (config.errorDevice, starNetDeviceContainer[1].Get (1));
+  Ptr<ErrorModel> errorModel = CreateErrorModel (config.errorModel, errRate);
+  if (errorModel)
+    {
+      errorDevice->SetReceiveErrorModel (errorModel);
+    }
 
   //============================
 
-  ApplicationContainer sinkApp = sinkHelper.Install (receiverNode);
+  ApplicationContainer sinkApp = InstallIfLocal (sinkHelper, receiverNode, config.rank);
   sinkApp.Start (Seconds (0.0));
   // this makes sure that the receiver will run one minute longer than the sender applicaton.
   sinkApp.Stop (Seconds (runtime + 60.0));
@@ -375,7 +2724,7 @@ int main (int argc, char *argv[])
   // ns3::Ptr<ns3::Node> bgSenderNode = internetNodes.Get(1);
   // Ipv4Address bgSenderAddr = starNetworks[0].GetSpokeIpv4Address(0);
 
-  ApplicationContainer bgSinkApp = sinkHelper.Install (bgReceiverNode);
+  ApplicationContainer bgSinkApp = InstallIfLocal (sinkHelper, bgReceiverNode, config.rank);
   // ApplicationContainer bgSinkApp2 = sinkHelper.Install (bgReceiverNode2);
   bgSinkApp.Start (Seconds (0.0));
   bgSinkApp.Stop (Seconds (runtime + 60.0));
@@ -400,8 +2749,16 @@ int main (int argc, char *argv[])
 
 
 
-  TypeId tid = TypeId::LookupByName ("ns3::TcpScalable");
-  Config::Set ("/NodeList/*/$ns3::TcpL4Protocol/SocketType", TypeIdValue (tid));
+  // set on the TCP of each node, instead of matching a path on all of them
+  TypeId tid = TypeId::LookupByName (config.socketType);
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+    {
+      Ptr<TcpL4Protocol> tcp = (*node)->GetObject<TcpL4Protocol> ();
+      if (tcp != 0)
+        {
+          tcp->SetAttribute ("SocketType", TypeIdValue (tid));
+        }
+    }
   // Config::Set ("/NodeList/*/$ns3::TcpSocketBase/SlowStartThreshold", UintegerValue(2621400));
   // Ptr<Socket> ns3TcpSocket = Socket::CreateSocket (senderNode, /*tid*/ TcpSocketFactory::GetTypeId ());
 
@@ -420,13 +2777,37 @@ int main (int argc, char *argv[])
   // app->SetStopTime (Seconds (60.0));
   //-------------
 
-  BulkSendHelper clientHelper ("ns3::TcpSocketFactory", remoteAddress);
-  clientHelper.SetAttribute ("MaxBytes", UintegerValue (0));
-  // OnOffHelper clientHelper ("ns3::TcpSocketFactory", remoteAddress);
-  // clientHelper.SetConstantRate(DataRate ("900kbps"), 512);
-  ApplicationContainer clientApp = clientHelper.Install (senderNode);
+  ApplicationContainer clientApp;
+  if (config.sender == "batch")
+    {
+      for (uint32_t flow = 0; flow < config.flows && senderNode->GetSystemId () == config.rank; flow++)
+        {
+          Ptr<Socket> socket = Socket::CreateSocket (senderNode, TcpSocketFactory::GetTypeId ());
+          Ptr<MyApp> app = CreateObject<MyApp> ();
+          app->Setup (socket, remoteAddress, 1000, std::numeric_limits<uint32_t>::max (), DataRate (config.senderRate));
+          senderNode->AddApplication (app);
+          clientApp.Add (app);
+        }
+    }
+  else
+    {
+      NS_ABORT_MSG_UNLESS (config.sender == "bulk", "Unknown sender " << config.sender);
+      BulkSendHelper clientHelper ("ns3::TcpSocketFactory", remoteAddress);
+      clientHelper.SetAttribute ("MaxBytes", UintegerValue (0));
+      // OnOffHelper clientHelper ("ns3::TcpSocketFactory", remoteAddress);
+      // clientHelper.SetConstantRate(DataRate ("900kbps"), 512);
+      for (uint32_t flow = 0; flow < config.flows; flow++)
+        {
+          clientApp.Add (InstallIfLocal (clientHelper, senderNode, config.rank));
+        }
+    }
   clientApp.Start(Seconds(1));
   clientApp.Stop(Seconds(runtime-2));
+  if (config.tcpStats)
+    {
+      // on the sender sockets, not as a default the next scenarios would keep
+      SetSenderSocketAttribute (clientApp, "StatsFile", prefix + "tcp-stats.csv");
+    }
 
 
   //noise
@@ -438,10 +2819,21 @@ int main (int argc, char *argv[])
   // clientApp.Stop(Seconds(runtime-2));
 
 // ==========
-  OnOffHelper bgClientHelper ("ns3::TcpSocketFactory", bgRemoteAddress);
-  bgClientHelper.SetConstantRate(DataRate (backgroundRate), 512);
-  // bgClientHelper.SetAttribute ("MaxBytes", UintegerValue (0));
-  ApplicationContainer bgClientApp = bgClientHelper.Install (bgSenderNode);
+  ApplicationContainer bgClientApp;
+  std::auto_ptr<FluidBackground> fluidBackground;
+  if (config.bgModel == "fluid")
+    {
+      fluidBackground.reset (new FluidBackground (bgSenderNode, bgReceiverAddr, DataRate (backgroundRate), 512,
+                                                  Seconds (config.bgFluidInterval), Seconds (0), Seconds (runtime)));
+    }
+  else
+    {
+      NS_ABORT_MSG_UNLESS (config.bgModel == "packet", "Unknown background model " << config.bgModel);
+      OnOffHelper bgClientHelper ("ns3::TcpSocketFactory", bgRemoteAddress);
+      bgClientHelper.SetConstantRate(DataRate (backgroundRate), 512);
+      // bgClientHelper.SetAttribute ("MaxBytes", UintegerValue (0));
+      bgClientApp = InstallIfLocal (bgClientHelper, bgSenderNode, config.rank);
+    }
   bgClientApp.Start(Seconds(0));
   bgClientApp.Stop(Seconds(runtime));
 // ==========
@@ -476,10 +2868,69 @@ int main (int argc, char *argv[])
   NS_LOG_UNCOND ("Sender at " << senderAddr << ":" << servPort << " @" << senderNode->GetId());
   // devices.Get (1)->TraceConnectWithoutContext ("PhyRxDrop", MakeCallback (&RxDrop));
 
-  p2pEndpoint.EnablePcapAll ("coursework");
+  // nodes simulated by this process, all of them unless distributed
+  NodeContainer localNodes;
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+    {
+      if ((*node)->GetSystemId () == config.rank)
+        {
+          localNodes.Add (*node);
+        }
+    }
+
+  std::vector<Ptr<BoundedPcapCapture> > captures;
+  std::vector<std::string> captureNames;
+  if (config.pcapMode == "full")
+    {
+      p2pEndpoint.EnablePcap (prefix + "coursework", localNodes);
+    }
+  else if (config.pcapMode == "headers")
+    {
+      // Same devices as EnablePcapAll, but truncated, windowed, compressed
+      // and rotated captures
+      for (NodeContainer::Iterator node = localNodes.Begin (); node != localNodes.End (); ++node)
+        {
+          for (uint32_t i = 0; i < (*node)->GetNDevices (); i++)
+            {
+              Ptr<NetDevice> device = (*node)->GetDevice (i);
+              if (DynamicCast<PointToPointNetDevice> (device) == 0)
+                {
+                  continue;
+                }
+              Ptr<BoundedPcapCapture> capture = CreateObject<BoundedPcapCapture> ();
+              std::string name = "coursework-" + SSTR ((*node)->GetId ()) + "-" + SSTR (i);
+              capture->Install (device, prefix + name);
+              captures.push_back (capture);
+              captureNames.push_back (name);
+            }
+        }
+    }
 
   FlowMonitorHelper flowmon;
-  Ptr<FlowMonitor> monitor = flowmon.Install( starNetworks[0].GetSpokeNode(0) );
+  // monitor both ends of the bulk flow, so that rx and delays are known
+  NodeContainer monitoredNodes;
+  if (senderNode->GetSystemId () == config.rank)
+    {
+      monitoredNodes.Add (senderNode);
+    }
+  if (receiverNode->GetSystemId () == config.rank)
+    {
+      monitoredNodes.Add (receiverNode);
+    }
+  Ptr<FlowMonitor> monitor = flowmon.Install (monitoredNodes);
+  std::auto_ptr<TcpWireMonitor> wire;
+  if (config.wireStats && senderNode->GetSystemId () == config.rank)
+    {
+      wire.reset (new TcpWireMonitor (Seconds (config.wireInterval), prefix + "flight.csv"));
+      wire->Install (senderNode);
+    }
+  std::auto_ptr<FlowStatsExporter> flowStats;
+  if (config.flowStatsInterval > 0)
+    {
+      flowStats.reset (new FlowStatsExporter (monitor, DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ()),
+                                              Seconds (config.flowStatsInterval), prefix + "flow-stats.csv",
+                                              Seconds (config.flowStatsBucket), 64));
+    }
 
   // sinkApp.Start (Seconds (0.0));
   // // this makes sure that the receiver will run one minute longer than the sender applicaton.
@@ -500,12 +2951,363 @@ int main (int argc, char *argv[])
   // // This tells ns-3 to generate pcap traces.
   // p2p.EnablePcapAll ("tcp-nsc-lfn");
 
+  std::auto_ptr<ConvergenceMonitor> convergence;
+  if (config.converge)
+    {
+      convergence.reset (new ConvergenceMonitor (DynamicCast<PacketSink> (sinkApp.Get (0)),
+                                                 clientApp.Get (0), Seconds (runtime - 2.0),
+                                                 Seconds (config.minTime), Seconds (config.batchInterval),
+                                                 config.ciTarget, config.minBatches));
+    }
+
   NS_LOG_UNCOND ("> Simulation");
 
   Simulator::Stop (Seconds (900));
-  Simulator::Run ();
-  monitor->SerializeToXmlFile ("results.xml", true, true);
+  bool isBranch = false;
+  if (!branchValues.empty ())
+    {
+      // The warm-up is simulated once; its outputs stay in the files of
+      // this process and each branch writes the rest into its directory.
+      Simulator::Stop (Seconds (config.branchTime));
+      RunSimulation ();
+      NS_LOG_UNCOND ("> Branching at " << Simulator::Now ().GetSeconds () << "s");
+      std::string branchPrefix = prefix + "branch-" + config.branchParam + "-";
+      int branch = ForkBranches (branchValues);
+      if (branch < 0)
+        {
+          // the summary of the run gathers the rows of the branches
+          std::ofstream summary ((prefix + config.summaryFile).c_str ());
+          for (size_t i = 0; i < branchValues.size (); i++)
+            {
+              std::ifstream branchSummary ((branchPrefix + branchValues[i] + "/" + config.summaryFile).c_str ());
+              std::string line;
+              for (int n = 0; std::getline (branchSummary, line); n++)
+                {
+                  if (n > 0 || i == 0)
+                    {
+                      summary << line << std::endl;
+                    }
+                }
+            }
+          BoundedPcapCapture::CompressAll ();
+          Simulator::Destroy ();
+          return ScenarioResult ();
+        }
+      isBranch = true;
+      const std::string &value = branchValues[branch];
+      std::string dir = branchPrefix + value;
+      NS_ABORT_MSG_IF (mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST, "Cannot create " << dir);
+      prefix = dir + "/";
+      TcpTraceBuffer::ReopenAll (dir);
+      for (size_t i = 0; i < captures.size (); i++)
+        {
+          captures[i]->Restart (prefix + captureNames[i]);
+        }
+      if (flowStats.get ())
+        {
+          flowStats->Reopen (prefix + "flow-stats.csv");
+        }
+
+      if (config.branchParam == "error-rate")
+        {
+          errRate = std::atof (value.c_str ());
+          // without --error-model, branches use the byte RateErrorModel
+          errorDevice->SetReceiveErrorModel (CreateErrorModel (config.errorModel == "none" ? "rate" : config.errorModel,
+                                                               errRate));
+        }
+      else
+        {
+          backgroundRate = value;
+          if (fluidBackground.get ())
+            {
+              fluidBackground->SetRate (DataRate (backgroundRate));
+            }
+          else
+            {
+              bgClientApp.Get (0)->SetAttribute ("DataRate", DataRateValue (DataRate (backgroundRate)));
+            }
+        }
+      NS_LOG_UNCOND ("> Branch " << config.branchParam << "=" << value << " in " << dir);
+    }
+  double runStart = WallSeconds ();
+  RunSimulation ();
+  double runWall = WallSeconds () - runStart;
+
+  // goodput over the time the bulk sender really ran
+  double sendTime = config.GetSendTime ();
+  std::string stopReason = "end";
+  if (convergence.get ())
+    {
+      convergence->Report ();
+      if (convergence->HasConverged ())
+        {
+          sendTime = Simulator::Now ().GetSeconds () - 1;
+          stopReason = "converged";
+        }
+    }
+  if (flowStats.get ())
+    {
+      flowStats->WriteHistograms (prefix + "flow-delay-histogram.csv");
+    }
+  else
+    {
+      monitor->SerializeToXmlFile (prefix + "results.xml", true, true);
+    }
+
+  // in a distributed run, only the rank of a sink counts its bytes
+  uint64_t rxBytes = sinkApp.GetN () > 0 ? DynamicCast<PacketSink> (sinkApp.Get (0))->GetTotalRx () : 0;
+  uint64_t bgRxBytes = bgSinkApp.GetN () > 0 ? DynamicCast<PacketSink> (bgSinkApp.Get (0))->GetTotalRx () : 0;
+  if (fluidBackground.get ())
+    {
+      bgRxBytes = fluidBackground->GetTotalBytes ();
+    }
+  WriteRunSummary (config, prefix, backgroundRate, SSTR (errRate), clientApp, rxBytes, bgRxBytes,
+                   sendTime, stopReason, runWall);
+  if (config.queueEndpoint != "droptail" || config.queueProvider != "droptail" || config.queueBackbone != "droptail")
+    {
+      WriteQueueStats (prefix + "queue-stats.csv", config.rank);
+    }
+
+  BoundedPcapCapture::CompressAll ();
+  ScenarioResult result = MakeResult (rxBytes, sendTime, runWall, wire.get ());
   Simulator::Destroy ();
+  if (isBranch)
+    {
+      // the parent carries on with the rest of the batch, if any
+      captures.clear ();
+      std::exit (0);
+    }
+  return result;
+}
+
+/**
+ * Attribute defaults of every scenario, set again after each Config::Reset.
+ */
+static void
+SetDefaults (void)
+{
+  Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (512));
+  // Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("1Mbps"));
+  // Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (TcpScalable::GetTypeId()));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize",  UintegerValue(1000));
+}
+
+/**
+ * Config::Reset, then the defaults of every scenario and the attribute
+ * arguments of the command line, as in a fresh process.
+ */
+static void
+ResetDefaults (const std::vector<std::string> &attributeArgs)
+{
+  Config::Reset ();
+  SetDefaults ();
+  std::vector<std::string> args (attributeArgs);
+  std::string program = "network";
+  std::vector<char *> argv (1, &program[0]);
+  for (size_t i = 0; i < args.size (); i++)
+    {
+      argv.push_back (&args[i][0]);
+    }
+  CommandLine cmd;
+  cmd.Parse (argv.size (), &argv[0]);
+}
+
+/**
+ * Run the same scenario with TcpScalable and with the Linux stack of NSC,
+ * and write their results side by side in tcp-compare.csv.
+ */
+static void
+RunTcpComparison (const ScenarioConfig &config, const std::string &prefix)
+{
+  NS_ABORT_MSG_IF (config.branchTime > 0, "--tcp=both cannot fork branches");
+  std::ofstream compare ((prefix + "tcp-compare.csv").c_str ());
+  compare << "stack,rxBytes,goodputKbps,retransmittedSegments,retransmittedBytes,"
+          << "events,wall_s,events_per_sim_s,wall_s_per_sim_s" << std::endl;
+
+  const char *stacks[] = { "scalable", "nsc" };
+  uint32_t rngRun = RngSeedManager::GetRun ();
+  for (int i = 0; i < 2; i++)
+    {
+      ScenarioConfig run = config;
+      run.tcp = stacks[i];
+      // retransmissions are counted on the wire, and the events by an
+      // InstrumentedScheduler, so that both stacks are measured alike
+      run.wireStats = true;
+      if (run.benchFile.empty ())
+        {
+          run.benchFile = "bench.csv";
+        }
+
+      // nothing the first stack set carries over to the second
+      ResetDefaults (config.attributeArgs);
+      RngSeedManager::SetRun (rngRun);
+      RngSeedManager::ResetNextStreamIndex ();
+      Ipv4AddressGenerator::Reset ();
+      NS_LOG_UNCOND ("> TCP stack " << run.tcp);
+      ScenarioResult result = RunScenario (run, prefix + run.tcp + "-");
+
+      compare << run.tcp << "," << result.rxBytes << "," << result.goodputKbps << ","
+              << result.retransmittedSegments << "," << result.retransmittedBytes << ","
+              << result.events << "," << result.wallSeconds << ","
+              << (result.simSeconds > 0 ? result.events / result.simSeconds : 0) << ","
+              << (result.simSeconds > 0 ? result.wallSeconds / result.simSeconds : 0) << std::endl;
+    }
+}
+
+/**
+ * Run one scenario, or compare the TCP stacks on it with --tcp=both.
+ */
+static void
+RunScenarios (const ScenarioConfig &config, const std::string &prefix)
+{
+  if (config.tcp == "both")
+    {
+      RunTcpComparison (config, prefix);
+    }
+  else
+    {
+      RunScenario (config, prefix);
+    }
+}
+
+/**
+ * Split one line of a batch file into command line arguments.
+ */
+static std::vector<std::string>
+SplitArguments (const std::string &line)
+{
+  std::vector<std::string> args;
+  std::istringstream in (line);
+  std::string arg;
+  while (in >> arg)
+    {
+      args.push_back (arg);
+    }
+  return args;
+}
+
+/**
+ * The arguments of a command line setting attribute defaults
+ * (--ns3::<TypeId>::<attribute>=<value>) or global values (e.g. --RngRun).
+ */
+static std::vector<std::string>
+GetAttributeArguments (int argc, char *argv[])
+{
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      std::string::size_type start = arg.find_first_not_of ('-');
+      std::string name = start == std::string::npos ? "" : arg.substr (start, arg.find ('=') - start);
+      bool global = false;
+      for (GlobalValue::Iterator g = GlobalValue::Begin (); g != GlobalValue::End (); ++g)
+        {
+          global = global || (*g)->GetName () == name;
+        }
+      if (global || name.compare (0, 5, "ns3::") == 0)
+        {
+          args.push_back (arg);
+        }
+    }
+  return args;
+}
+
+int main (int argc, char *argv[])
+{
+  NS_LOG_UNCOND ("> Parse configuration");
+  SetDefaults ();
+
+  ScenarioConfig config;
+  // file with one scenario per line, each line holding command line options
+  std::string batchFile = "";
+  // partition the ring across the MPI processes started by mpirun
+  bool distributed = false;
+  CommandLine cmd;
+  config.AddValues (cmd);
+  cmd.AddValue ("batch", "Run the scenarios listed in this file, one set of options per line", batchFile);
+  cmd.AddValue ("distributed", "Partition the topology across MPI processes, run with mpirun "
+                "(needs ns-3 configured with --enable-mpi)", distributed);
+  cmd.Parse (argc, argv);
+  config.Check ();
+  config.attributeArgs = GetAttributeArguments (argc, argv);
+
+  if (distributed)
+    {
+      NS_ABORT_MSG_UNLESS (batchFile.empty (), "Batches cannot run distributed");
+      NS_ABORT_MSG_IF (config.converge, "The convergence test needs all the nodes in one process");
+      NS_ABORT_MSG_IF (config.branchTime > 0, "Distributed runs cannot fork branches");
+      NS_ABORT_MSG_IF (config.tcp == "both", "Distributed runs cannot compare TCP stacks");
+#ifdef NS3_MPI
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::DistributedSimulatorImpl"));
+      MpiInterface::Enable (&argc, &argv);
+      config.rank = MpiInterface::GetSystemId ();
+      config.ranks = MpiInterface::GetSize ();
+      // each rank writes its own outputs, merged by merge-ranks.sh
+      RunScenario (config, "r" + SSTR (config.rank) + "-");
+      MpiInterface::Disable ();
+#else
+      NS_FATAL_ERROR ("Distributed mode needs ns-3 configured with --enable-mpi");
+#endif
+      return 0;
+    }
+
+  if (batchFile.empty ())
+    {
+      RunScenarios (config, "");
+      return 0;
+    }
+
+  // Run all the scenarios back to back in this process, so that the
+  // startup cost is paid once. Options not given on a line keep the
+  // values given on the command line.
+  std::ifstream batch (batchFile.c_str ());
+  NS_ABORT_MSG_UNLESS (batch, "Cannot open batch file " << batchFile);
+  uint32_t rngRun = RngSeedManager::GetRun ();
+  std::string line;
+  for (int scenarioId = 0; std::getline (batch, line); )
+    {
+      std::vector<std::string> args = SplitArguments (line);
+      if (args.empty () || args[0][0] == '#')
+        {
+          continue;
+        }
+      // the attributes of the command line first, so that the line overrides them
+      args.insert (args.begin (), config.attributeArgs.begin (), config.attributeArgs.end ());
+      std::vector<char *> scenarioArgv;
+      scenarioArgv.push_back (argv[0]);
+      for (size_t i = 0; i < args.size (); i++)
+        {
+          scenarioArgv.push_back (&args[i][0]);
+        }
+
+      // Start from the same state as a fresh process: the attribute
+      // defaults and global values of the command line only, whatever the
+      // previous lines or scenarios set, the same random streams for the
+      // same RngRun, and no address left over from the last topology.
+      Config::Reset ();
+      SetDefaults ();
+      RngSeedManager::SetRun (rngRun);
+      ScenarioConfig scenario = config;
+      CommandLine scenarioCmd;
+      scenario.AddValues (scenarioCmd);
+      scenarioCmd.Parse (scenarioArgv.size (), &scenarioArgv[0]);
+      scenario.Check ();
+      scenario.attributeArgs = GetAttributeArguments (scenarioArgv.size (), &scenarioArgv[0]);
+
+      RngSeedManager::ResetNextStreamIndex ();
+      Ipv4AddressGenerator::Reset ();
+
+      std::string prefix = "s" + SSTR (scenarioId) + "-";
+      NS_LOG_UNCOND ("> Scenario " << scenarioId << ": " << line);
+      RunScenarios (scenario, prefix);
+
+      std::string results = scenario.tcp == "both" ? "tcp-compare.csv" : scenario.summaryFile;
+      std::ifstream summary ((prefix + results).c_str ());
+      std::cout << "=== scenario " << scenarioId << " " << line << std::endl
+                << summary.rdbuf ()
+                << "=== end" << std::endl;
+      scenarioId++;
+    }
 
   return 0;
 }
@@ -0,0 +1,293 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Microbenchmark of the ACK path of TcpScalable.
+ *
+ * A TcpScalable socket is connected over one point-to-point link, then its
+ * NewAck, DupAck and Retransmit handlers are called directly with
+ * synthetic ACK sequences, without running the simulator in between. The
+ * events they schedule (transmissions, cancelled timers) would pile up in
+ * the scheduler, so every batch of ACKs gets a fresh socket and simulator,
+ * set up outside of the timed part:
+ *
+ *   steady  new ACKs of one segment
+ *   loss    bursts of duplicate ACKs with fast retransmit, a partial and
+ *           a full ACK, between runs of new ACKs
+ *   rto     retransmission timeouts, each followed by a few new ACKs
+ *
+ * Results are written as "benchmark,metric,value" lines, like the --bench
+ * output of scratch/network; bench-compare.sh compares two such files.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <ctime>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/tcp-scalable.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpScalableBench");
+
+/// ACKs handled by one socket, a multiple of the 30 and 5 ACK patterns
+static const uint32_t ACK_BATCH = 3000;
+
+/**
+ * TcpScalable with its ACK handlers made callable from the benchmark.
+ */
+class TcpScalableProbe : public TcpScalable
+{
+public:
+  static TypeId GetTypeId (void);
+
+  void Ack (SequenceNumber32 seq)
+  {
+    NewAck (seq);
+  }
+
+  void Dup (uint32_t count)
+  {
+    TcpHeader header;
+    DupAck (header, count);
+  }
+
+  void Timeout (void)
+  {
+    Retransmit ();
+  }
+
+  SequenceNumber32 GetUna (void) const
+  {
+    return m_txBuffer->HeadSequence ();
+  }
+
+  SequenceNumber32 GetHighTx (void) const
+  {
+    return m_highTxMark;
+  }
+
+  uint32_t GetSegmentSize (void) const
+  {
+    return m_segmentSize;
+  }
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TcpScalableProbe);
+
+TypeId
+TcpScalableProbe::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpScalableProbe")
+    .SetParent<TcpScalable> ()
+    .AddConstructor<TcpScalableProbe> ()
+  ;
+  return tid;
+}
+
+static double
+WallSeconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Probe socket connected over one link, with its send buffer kept full.
+ */
+class AckBench
+{
+public:
+  AckBench ();
+  ~AckBench ();
+
+  /// New ACK of one segment, or of what is left in flight
+  void NewAck (void);
+  void DupAcks (uint32_t first, uint32_t last);
+  void Timeout (void);
+
+  Ptr<TcpScalableProbe> probe;
+
+private:
+  /// Keep the send buffer full, so that every ACK lets new data out
+  void Fill (void);
+};
+
+AckBench::AckBench ()
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", StringValue ("10Gbps"));
+  p2p.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  NetDeviceContainer devices = p2p.Install (nodes);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), 8080));
+  sink.Install (nodes.Get (1));
+
+  nodes.Get (0)->GetObject<TcpL4Protocol> ()->SetAttribute ("SocketType", TypeIdValue (TcpScalableProbe::GetTypeId ()));
+  probe = DynamicCast<TcpScalableProbe> (Socket::CreateSocket (nodes.Get (0), TcpSocketFactory::GetTypeId ()));
+  probe->Bind ();
+  probe->Connect (InetSocketAddress (interfaces.GetAddress (1), 8080));
+
+  // Let the handshake complete, and nothing else.
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+  Fill ();
+}
+
+AckBench::~AckBench ()
+{
+  probe = 0;
+  Simulator::Destroy ();
+}
+
+void
+AckBench::Fill (void)
+{
+  uint32_t available = probe->GetTxAvailable ();
+  if (available >= 64 * probe->GetSegmentSize ())
+    {
+      probe->Send (Create<Packet> (available));
+    }
+}
+
+void
+AckBench::NewAck (void)
+{
+  Fill ();
+  SequenceNumber32 ack = std::min (probe->GetUna () + probe->GetSegmentSize (), probe->GetHighTx ());
+  probe->Ack (ack);
+}
+
+void
+AckBench::DupAcks (uint32_t first, uint32_t last)
+{
+  for (uint32_t count = first; count <= last; count++)
+    {
+      probe->Dup (count);
+    }
+}
+
+void
+AckBench::Timeout (void)
+{
+  probe->Timeout ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t acks = 200000;
+  std::string out = "tcp-scalable-bench.csv";
+  CommandLine cmd;
+  cmd.AddValue ("acks", "ACKs handled by each benchmark (default 200000)", acks);
+  cmd.AddValue ("out", "Results file (default tcp-scalable-bench.csv)", out);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1000));
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  std::ofstream results (out.c_str ());
+  results << "benchmark,metric,value" << std::endl;
+
+  {
+    uint32_t handled = 0;
+    double elapsed = 0;
+    while (handled < acks)
+      {
+        AckBench bench;
+        double start = WallSeconds ();
+        for (uint32_t i = 0; i < ACK_BATCH; i++)
+          {
+            bench.NewAck ();
+          }
+        elapsed += WallSeconds () - start;
+        handled += ACK_BATCH;
+      }
+    results << "ack-steady,ns_per_ack," << elapsed * 1e9 / handled << std::endl;
+  }
+
+  {
+    // 20 new ACKs, 8 duplicate ACKs, a partial and a full ACK
+    uint32_t handled = 0;
+    double elapsed = 0;
+    while (handled < acks)
+      {
+        AckBench bench;
+        double start = WallSeconds ();
+        for (uint32_t n = 0; n < ACK_BATCH; n += 30)
+          {
+            for (int i = 0; i < 20; i++)
+              {
+                bench.NewAck ();
+              }
+            bench.DupAcks (1, 8);
+            bench.NewAck ();
+            bench.probe->Ack (bench.probe->GetHighTx ());
+          }
+        elapsed += WallSeconds () - start;
+        handled += ACK_BATCH;
+      }
+    results << "ack-loss,ns_per_ack," << elapsed * 1e9 / handled << std::endl;
+  }
+
+  {
+    // a timeout every 5 ACKs
+    uint32_t handled = 0;
+    double elapsed = 0;
+    while (handled < acks)
+      {
+        AckBench bench;
+        double start = WallSeconds ();
+        for (uint32_t n = 0; n < ACK_BATCH; n += 5)
+          {
+            bench.Timeout ();
+            for (int i = 0; i < 4; i++)
+              {
+                bench.NewAck ();
+              }
+          }
+        elapsed += WallSeconds () - start;
+        handled += ACK_BATCH;
+      }
+    results << "ack-rto,ns_per_ack," << elapsed * 1e9 / handled << std::endl;
+  }
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  results << "ack,max_rss_kb," << usage.ru_maxrss << std::endl;
+  results.close ();
+
+  std::ifstream summary (out.c_str ());
+  std::cout << summary.rdbuf ();
+  return 0;
+}
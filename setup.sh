@@ -21,7 +21,7 @@ cd /work
             python scons.py
         )
 
-        ./build.py --enable-examples
+        ./build.py --enable-examples -- --enable-mpi
     )
 )
 
@@ -29,8 +29,18 @@ rm -rf workspace/ns3-allinone/scratch
 ln -sf /work/scratch workspace/ns3-allinone/scratch
 ln -sf /work/model/* workspace/ns3-allinone/src/internet/model
 
-if ! grep tcp-scalable
-then
-    echo "    obj.source.append('model/tcp-scalable.cc')" >> workspace/ns3-allinone/src/internet/wscript
-    echo "    headers.source.append('model/tcp-scalable.h')" >> workspace/ns3-allinone/src/internet/wscript
-fi
+for src in model/*.cc
+do
+    if ! grep -q "'$src'" workspace/ns3-allinone/src/internet/wscript
+    then
+        echo "    obj.source.append('$src')" >> workspace/ns3-allinone/src/internet/wscript
+    fi
+done
+
+for hdr in model/*.h
+do
+    if ! grep -q "'$hdr'" workspace/ns3-allinone/src/internet/wscript
+    then
+        echo "    headers.source.append('$hdr')" >> workspace/ns3-allinone/src/internet/wscript
+    fi
+done
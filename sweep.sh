@@ -0,0 +1,84 @@
+#!/bin/bash
+# Run scratch/network over a parameter grid, in parallel.
+#
+# Every grid point gets its own directory (LOG, pcap, results.xml,
+# summary.csv) and is run once per RNG run number of --runs; the per-run
+# summaries are merged into <out>/summary.csv when all runs are done.
+#
+# The run numbers are not derived from the grid point: with the default
+# --runs "1", every point uses the same random streams (common random
+# numbers), so that differences between points come from the parameters.
+# List several run numbers to get independent replications of each point.
+#
+# Usage (inside the container, from the ns-3 directory):
+#   sweep.sh [--bg-rates "1kbps 21kbps"] [--error-rates "0.000001"]
+#            [--runtimes "300"] [--runs "1 2 3"] [--jobs N] [--out DIR]
+#            [-- extra scratch/network arguments]
+
+bgRates="10kbps"
+errorRates="0.000001"
+runtimes="300"
+runs="1"
+jobs=$(nproc)
+out=/work/sweep
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+        --bg-rates) bgRates="$2"; shift 2;;
+        --error-rates) errorRates="$2"; shift 2;;
+        --runtimes) runtimes="$2"; shift 2;;
+        --runs) runs="$2"; shift 2;;
+        --jobs) jobs="$2"; shift 2;;
+        --out) out="$2"; shift 2;;
+        --) shift; break;;
+        *) echo "Unknown option $1" >&2; exit 1;;
+    esac
+done
+
+# Build once, then start the binary directly: concurrent "./waf --run"
+# would all check and store the build state at the same time.
+./waf build > /dev/null || exit 1
+program=$(find "$PWD/build/scratch" -maxdepth 1 -type f -perm -u+x -name '*network*' | head -n 1)
+if [ -z "$program" ]
+then
+    echo "scratch/network is not built" >&2
+    exit 1
+fi
+
+export LD_LIBRARY_PATH="$PWD/build:$PWD/build/lib:$LD_LIBRARY_PATH"
+export program out
+export extraArgs="$*"
+
+run_one() {
+    dir="$out/bg-$1_err-$2_rt-$3_run-$4"
+    mkdir -p "$dir"
+    cd "$dir" || return 1
+    "$program" --bgRate="$1" --error-rate="$2" --runtime="$3" --RngRun="$4" $extraArgs &> LOG
+    echo "done $dir (exit $?)"
+}
+export -f run_one
+
+mkdir -p "$out"
+for bg in $bgRates; do
+    for err in $errorRates; do
+        for rt in $runtimes; do
+            for run in $runs; do
+                echo "$bg $err $rt $run"
+            done
+        done
+    done
+done | xargs -P "$jobs" -n 4 bash -c 'run_one "$@"' run_one
+
+first=1
+for summary in "$out"/*/summary.csv
+do
+    [ -f "$summary" ] || continue
+    if [ $first = 1 ]
+    then
+        head -n 1 "$summary" | sed 's/^/dir,/' > "$out/summary.csv"
+        first=0
+    fi
+    tail -n +2 "$summary" | sed "s|^|$(basename "$(dirname "$summary")"),|" >> "$out/summary.csv"
+done
+echo "Merged summary in $out/summary.csv"
@@ -1,22 +1,10 @@
-rate=100
+[ -x tools/flow-trace-plot ] || g++ -O2 -o tools/flow-trace-plot tools/flow-trace-plot.cc
 
-for rate in `seq 0.0000001 0.0000005 0.000005`
+vagga sweep --error-rates "$(seq 0.0000001 0.0000005 0.000005)" --out /work/err -- --error-model=geometric --ns3::TcpScalable::TracePrefix=flow- --ns3::TcpScalable::TraceInterval=0.05s
+
+for dir in err/*/
 do
-    echo ${rate}
-    vagga waf --run "scratch/network --error-rate=${rate}" &> LOG
-    grep CSV LOG > csv.csv
-    cat csv.csv | awk -F, '{print $2}' | sort -u > streams.list
-    mkdir -p ${rate}
-    mv *.pcap ./${rate}/
-    id=0
-    for s in `cat streams.list`; do
-        echo $s
-        id=$((id+1))
-        grep "$s" csv.csv > csv.$id.csv
-        gnuplot -e "set output '${rate}/${rate}-$id-window.png'; set datafile separator ','; set term png; plot 'csv.$id.csv' using 3:4 with line;"
-        gnuplot -e "set output '${rate}/${rate}-$id-threshold.png'; set datafile separator ','; set term png; plot 'csv.$id.csv' using 3:5 with line;"
-    done
+    echo ${dir}
+    # one pass over all the flows of the run, then one gnuplot for both plots
+    tools/flow-trace-plot -n 4000 -o ${dir%/} ${dir}flow-*.ftr && gnuplot ${dir}plot.gp
 done
-
-# cat streams.list | xargs -I % grep % csv.csv > csv.1.csv
-# gnuplot -e 'set datafile separator ","; set output "t.png"; plot "csv.csv" using 3:4 with line; pause -1;'
@@ -0,0 +1,60 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Print a flow trace file as CSV: time (s), cwnd, ssthresh, event.
+ *
+ *   g++ -O2 -o tools/flow-trace-dump tools/flow-trace-dump.cc
+ *   tools/flow-trace-dump flow-node5-....ftr > flow.csv
+ */
+
+#include "flow-trace-reader.h"
+
+#include <cstdio>
+
+int
+main (int argc, char *argv[])
+{
+  if (argc != 2)
+    {
+      std::fprintf (stderr, "usage: %s <flow trace file>\n", argv[0]);
+      return 1;
+    }
+
+  ns3::FlowTraceReader reader;
+  if (!reader.Open (argv[1]))
+    {
+      std::fprintf (stderr, "%s: not a flow trace file\n", argv[1]);
+      return 1;
+    }
+
+  std::vector<ns3::FlowTraceSample> samples;
+  for (size_t b = 0; b < reader.GetNBlocks (); b++)
+    {
+      samples.clear ();
+      if (!reader.ReadBlock (b, samples))
+        {
+          std::fprintf (stderr, "%s: block %u is corrupted\n", argv[1], static_cast<unsigned> (b));
+          return 1;
+        }
+      for (size_t i = 0; i < samples.size (); i++)
+        {
+          std::printf ("%.9f,%u,%u,%u\n", samples[i].time / 1e9, samples[i].cwnd,
+                       samples[i].ssThresh, static_cast<unsigned> (samples[i].event));
+        }
+    }
+  return 0;
+}
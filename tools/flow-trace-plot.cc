@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * Downsample flow trace files and write a gnuplot script plotting the
+ * window and the threshold of all of them, reading every file once.
+ *
+ *   g++ -O2 -o tools/flow-trace-plot tools/flow-trace-plot.cc
+ *   tools/flow-trace-plot [-n points] [-o dir] flow-*.ftr
+ *   gnuplot dir/plot.gp
+ *
+ * Every flow is reduced to at most <points> samples (default 2000) with the
+ * min/max per time bucket of FlowTraceDownsampler, written to
+ * dir/flow-<n>.csv as time (s), cwnd, ssthresh. dir/plot.gp draws
+ * dir/window.png and dir/threshold.png, one line per flow.
+ */
+
+#include "flow-trace-reader.h"
+#include "../model/flow-trace-downsampler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+namespace {
+
+/// Downsampler sink writing CSV lines
+struct CsvWriter
+{
+  explicit CsvWriter (FILE *f)
+    : file (f)
+  {
+  }
+  void operator() (const ns3::FlowTraceSample &s) const
+  {
+    std::fprintf (file, "%.9f,%u,%u\n", s.time / 1e9, s.cwnd, s.ssThresh);
+  }
+  FILE *file;
+};
+
+std::string
+FormatAddress (uint32_t address, uint16_t port)
+{
+  char text[32];
+  std::snprintf (text, sizeof (text), "%u.%u.%u.%u:%u", address >> 24, (address >> 16) & 0xff,
+                 (address >> 8) & 0xff, address & 0xff, port);
+  return text;
+}
+
+/// Time of the first or the last sample of a trace, -1 if it has none
+int64_t
+SampleTime (const ns3::FlowTraceReader &reader, bool last)
+{
+  std::vector<ns3::FlowTraceSample> samples;
+  if (reader.GetNBlocks () == 0
+      || !reader.ReadBlock (last ? reader.GetNBlocks () - 1 : 0, samples)
+      || samples.empty ())
+    {
+      return -1;
+    }
+  return last ? samples.back ().time : samples.front ().time;
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  unsigned long points = 2000;
+  std::string dir = ".";
+  int opt;
+  while ((opt = getopt (argc, argv, "n:o:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'n':
+          points = std::strtoul (optarg, 0, 10);
+          break;
+        case 'o':
+          dir = optarg;
+          break;
+        default:
+          optind = argc + 1;
+          break;
+        }
+    }
+  if (optind >= argc || points < 4)
+    {
+      std::fprintf (stderr, "usage: %s [-n points (>= 4)] [-o dir] <flow trace file>...\n", argv[0]);
+      return 1;
+    }
+
+  std::vector<std::string> csvFiles;
+  std::vector<std::string> titles;
+  std::vector<ns3::FlowTraceSample> samples;
+  for (int arg = optind; arg < argc; arg++)
+    {
+      ns3::FlowTraceReader reader;
+      if (!reader.Open (argv[arg]))
+        {
+          std::fprintf (stderr, "%s: not a flow trace file, skipped\n", argv[arg]);
+          continue;
+        }
+      int64_t start = SampleTime (reader, false);
+      int64_t end = SampleTime (reader, true);
+      if (start < 0 || end < 0)
+        {
+          std::fprintf (stderr, "%s: no samples, skipped\n", argv[arg]);
+          continue;
+        }
+      // at most four samples per bucket
+      int64_t bucket = (end - start) / static_cast<int64_t> (points / 4) + 1;
+
+      char name[32];
+      std::snprintf (name, sizeof (name), "flow-%u.csv", static_cast<unsigned> (csvFiles.size () + 1));
+      std::string csvFile = dir + "/" + name;
+      FILE *csv = std::fopen (csvFile.c_str (), "w");
+      if (csv == 0)
+        {
+          std::perror (csvFile.c_str ());
+          return 1;
+        }
+      ns3::FlowTraceDownsampler<ns3::FlowTraceSample, CsvWriter> downsampler (bucket, CsvWriter (csv));
+      for (size_t b = 0; b < reader.GetNBlocks (); b++)
+        {
+          samples.clear ();
+          if (!reader.ReadBlock (b, samples))
+            {
+              std::fprintf (stderr, "%s: block %u is corrupted, trace cut\n", argv[arg], static_cast<unsigned> (b));
+              break;
+            }
+          for (size_t i = 0; i < samples.size (); i++)
+            {
+              downsampler.Add (samples[i]);
+            }
+        }
+      downsampler.Finish ();
+      std::fclose (csv);
+
+      const ns3::FlowTraceFileHeader &flow = reader.GetFlow ();
+      csvFiles.push_back (csvFile);
+      titles.push_back (FormatAddress (flow.localAddress, flow.localPort) + " > "
+                        + FormatAddress (flow.peerAddress, flow.peerPort));
+    }
+  if (csvFiles.empty ())
+    {
+      std::fprintf (stderr, "no flow to plot\n");
+      return 1;
+    }
+
+  std::string scriptFile = dir + "/plot.gp";
+  FILE *script = std::fopen (scriptFile.c_str (), "w");
+  if (script == 0)
+    {
+      std::perror (scriptFile.c_str ());
+      return 1;
+    }
+  std::fprintf (script, "set datafile separator ','\n"
+                "set term png size 1280,720\n"
+                "set xlabel 'time (s)'\n"
+                "set key outside bottom center\n");
+  const char *series[2][3] = { { "window", "cwnd (bytes)", "2" }, { "threshold", "ssthresh (bytes)", "3" } };
+  for (int s = 0; s < 2; s++)
+    {
+      std::fprintf (script, "set output '%s/%s.png'\nset ylabel '%s'\nplot", dir.c_str (), series[s][0], series[s][1]);
+      for (size_t i = 0; i < csvFiles.size (); i++)
+        {
+          std::fprintf (script, "%s '%s' using 1:%s with lines title '%s'", i == 0 ? "" : ",",
+                        csvFiles[i].c_str (), series[s][2], titles[i].c_str ());
+        }
+      std::fprintf (script, "\n");
+    }
+  std::fclose (script);
+  return 0;
+}
@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_TRACE_READER_H
+#define FLOW_TRACE_READER_H
+
+/*
+ * Header-only reader of the per-flow trace files written by TcpScalable.
+ * It does not depend on ns-3: plotting and analysis tools only need this
+ * file and model/flow-trace-format.h.
+ *
+ *   ns3::FlowTraceReader reader;
+ *   if (reader.Open ("flow-node5-12.0.0.2.49153-12.0.0.14.8080.ftr"))
+ *     {
+ *       std::vector<ns3::FlowTraceSample> samples;
+ *       reader.ReadAll (samples);
+ *     }
+ */
+
+#include "../model/flow-trace-format.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+/**
+ * \brief One decoded sample of a flow trace
+ */
+struct FlowTraceSample
+{
+  int64_t  time;     //!< Simulation time, in nanoseconds
+  uint32_t cwnd;     //!< Congestion window, in bytes
+  uint32_t ssThresh; //!< Slow start threshold, in bytes
+  uint8_t  event;    //!< TcpTraceRecord::Event
+};
+
+/**
+ * \brief Memory-mapped flow trace file
+ *
+ * The file is mapped once; blocks are located by walking their headers
+ * and decoded on demand, column by column.
+ */
+class FlowTraceReader
+{
+public:
+  FlowTraceReader ()
+    : m_data (0),
+      m_size (0)
+  {
+  }
+
+  ~FlowTraceReader ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Map a trace file and index its blocks
+   * \return false if the file cannot be read or is not a flow trace
+   */
+  bool Open (const char *fileName)
+  {
+    Close ();
+    int fd = open (fileName, O_RDONLY);
+    if (fd < 0)
+      {
+        return false;
+      }
+    struct stat st;
+    if (fstat (fd, &st) != 0 || static_cast<size_t> (st.st_size) < sizeof (FlowTraceFileHeader))
+      {
+        close (fd);
+        return false;
+      }
+    void *data = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED)
+      {
+        return false;
+      }
+    m_data = static_cast<const uint8_t *> (data);
+    m_size = st.st_size;
+    std::memcpy (&m_header, m_data, sizeof (m_header));
+    if (std::memcmp (m_header.magic, FLOW_TRACE_MAGIC, sizeof (m_header.magic)) != 0)
+      {
+        Close ();
+        return false;
+      }
+
+    // A block cut short by a crashed writer ends the index.
+    size_t offset = sizeof (FlowTraceFileHeader);
+    while (offset + sizeof (FlowTraceBlockHeader) <= m_size)
+      {
+        FlowTraceBlockHeader block;
+        std::memcpy (&block, m_data + offset, sizeof (block));
+        size_t end = offset + sizeof (block) + block.timeBytes + block.cwndBytes
+          + block.ssThreshBytes + block.count;
+        if (end > m_size)
+          {
+            break;
+          }
+        m_blocks.push_back (offset);
+        offset = end;
+      }
+    return true;
+  }
+
+  /**
+   * \brief Unmap the file
+   */
+  void Close (void)
+  {
+    if (m_data)
+      {
+        munmap (const_cast<uint8_t *> (m_data), m_size);
+      }
+    m_data = 0;
+    m_size = 0;
+    m_blocks.clear ();
+  }
+
+  /**
+   * \return the header identifying the flow
+   */
+  const FlowTraceFileHeader & GetFlow (void) const
+  {
+    return m_header;
+  }
+
+  /**
+   * \return the number of complete blocks in the file
+   */
+  size_t GetNBlocks (void) const
+  {
+    return m_blocks.size ();
+  }
+
+  /**
+   * \brief Decode one block
+   * \param index index of the block
+   * \param samples receives the samples of the block, appended
+   * \return false if the block is corrupted
+   */
+  bool ReadBlock (size_t index, std::vector<FlowTraceSample> &samples) const
+  {
+    FlowTraceBlockHeader block;
+    std::memcpy (&block, m_data + m_blocks[index], sizeof (block));
+    const uint8_t *time = m_data + m_blocks[index] + sizeof (block);
+    const uint8_t *timeEnd = time + block.timeBytes;
+    const uint8_t *cwnd = timeEnd;
+    const uint8_t *cwndEnd = cwnd + block.cwndBytes;
+    const uint8_t *ssThresh = cwndEnd;
+    const uint8_t *ssThreshEnd = ssThresh + block.ssThreshBytes;
+    const uint8_t *event = ssThreshEnd;
+
+    size_t first = samples.size ();
+    samples.resize (first + block.count);
+    int64_t lastTime = 0;
+    int64_t lastCwnd = 0;
+    int64_t lastSsThresh = 0;
+    for (uint32_t i = 0; i < block.count; i++)
+      {
+        uint64_t v;
+        if (!FlowTraceGetVarint (time, timeEnd, v))
+          {
+            return false;
+          }
+        lastTime += v;
+        if (!FlowTraceGetVarint (cwnd, cwndEnd, v))
+          {
+            return false;
+          }
+        lastCwnd += FlowTraceUnZigZag (v);
+        if (!FlowTraceGetVarint (ssThresh, ssThreshEnd, v))
+          {
+            return false;
+          }
+        lastSsThresh += FlowTraceUnZigZag (v);
+
+        FlowTraceSample &s = samples[first + i];
+        s.time = lastTime;
+        s.cwnd = static_cast<uint32_t> (lastCwnd);
+        s.ssThresh = static_cast<uint32_t> (lastSsThresh);
+        s.event = event[i];
+      }
+    return true;
+  }
+
+  /**
+   * \brief Decode the whole file
+   * \param samples receives all the samples, appended
+   * \return false if a block is corrupted
+   */
+  bool ReadAll (std::vector<FlowTraceSample> &samples) const
+  {
+    for (size_t i = 0; i < m_blocks.size (); i++)
+      {
+        if (!ReadBlock (i, samples))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+private:
+  FlowTraceReader (const FlowTraceReader &);
+  FlowTraceReader & operator= (const FlowTraceReader &);
+
+  const uint8_t      *m_data;   //!< Mapped file
+  size_t              m_size;   //!< Size of the mapping
+  FlowTraceFileHeader m_header; //!< Flow of the file
+  std::vector<size_t> m_blocks; //!< Offset of every complete block
+};
+
+} // namespace ns3
+
+#endif /* FLOW_TRACE_READER_H */